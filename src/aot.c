@@ -0,0 +1,254 @@
+#include "aot.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "code.h"
+
+static const char * const NAMES[] = {
+  "FST", "SND", "ACC", "PUSH", "SWAP", "CONS", "CUR", "CLOS", "APP", "TAPP",
+  "RET", "QUOTE", "PLUS", "HALT"
+};
+
+static void Body(aot_t * const, const code_t * const, const size_t,
+                 const size_t, const size_t);
+static bool Inline(const opcode_t);
+static bool Projects(const code_t * const, const size_t, const size_t);
+static void Translate(aot_t * const, const instr_t * const, const size_t,
+                      const size_t);
+
+void
+Aot_Init(aot_t * const me, FILE * const out)
+{
+  assert(me);
+  assert(out);
+
+  me->out = out;
+  me->nterms = 0;
+  fprintf(out, "/* Generated by --emit-c. */\n"
+               "#include <stdio.h>\n"
+               "#include <stdlib.h>\n\n"
+               "#include \"cam.h\"\n"
+               "#include \"code.h\"\n"
+               "#include \"context.h\"\n"
+               "#include \"env.h\"\n"
+               "#include \"except.h\"\n");
+}
+
+void
+Aot_Term(aot_t * const me, const code_t * const code)
+{
+  size_t  k;
+  size_t  i;
+
+  assert(me);
+  assert(code);
+
+  k = me->nterms++;
+
+  for (i = 0; i < code->len && Inline(code->start[i].op); ++i) {
+    continue;
+  }
+  if (i < code->len) {
+    fprintf(me->out, "\nstatic const instr_t code_%zu[] = {\n", k);
+    for (i = 0; i < code->len; ++i) {
+      fprintf(me->out, "  { NULL, OP_%s, %d },\n", NAMES[code->start[i].op],
+              code->start[i].arg);
+    }
+    fprintf(me->out, "};\n");
+  }
+  fprintf(me->out, "\n");
+  fprintf(me->out, "static void Run_%zu_0(cam_t * const);\n", k);
+  for (i = 0; i < code->len; ++i) {
+    if (code->start[i].op == OP_CUR) {
+      fprintf(me->out, "static void Run_%zu_%zu(cam_t * const);\n", k, i + 1);
+    }
+  }
+  for (i = 0; i < code->len; ++i) {
+    if (code->start[i].op == OP_APP || code->start[i].op == OP_TAPP) {
+      break;
+    }
+  }
+  if (i < code->len) {
+    fprintf(me->out, "\nstatic void\n"
+                     "Apply_%zu(cam_t * const cam, const instr_t * const pc)\n"
+                     "{\n"
+                     "  switch (pc - code_%zu) {\n", k, k);
+    for (i = 0; i < code->len; ++i) {
+      if (code->start[i].op == OP_CUR) {
+        fprintf(me->out, "  case %zu:\n"
+                         "    Run_%zu_%zu(cam);\n"
+                         "    break;\n", i + 1, k, i + 1);
+      }
+    }
+    fprintf(me->out, "  default:\n"
+                     "    abort();\n"
+                     "  }\n"
+                     "}\n");
+  }
+  Body(me, code, k, 0, code->len);
+  for (i = 0; i < code->len; ++i) {
+    if (code->start[i].op == OP_CUR) {
+      Body(me, code, k, i + 1, i + (size_t)code->start[i].arg);
+    }
+  }
+  fprintf(me->out, "\nstatic int\n"
+                   "Term_%zu(cam_context_t * const ctx)\n"
+                   "{\n"
+                   "  cam_t cam;\n"
+                   "  int   result;\n\n"
+                   "  Cam_Init(&cam, ctx);\n"
+                   "  Run_%zu_0(&cam);\n"
+                   "  result = Env_Num(cam.env);\n"
+                   "  Cam_Free(&cam);\n"
+                   "  return result;\n"
+                   "}\n", k, k);
+}
+
+static void
+Body(aot_t * const me, const code_t * const code, const size_t k,
+     const size_t start, const size_t end)
+{
+  size_t  i;
+
+  fprintf(me->out, "\nstatic void\n"
+                   "Run_%zu_%zu(cam_t * const cam)\n"
+                   "{\n"
+                   "  env_t * env = cam->env;\n", k, start);
+  if (Projects(code, start, end)) {
+    fprintf(me->out, "  env_t * proj;\n");
+  }
+  fprintf(me->out, "\n");
+  for (i = start; i < end; ++i) {
+    Translate(me, &code->start[i], k, i);
+    if (code->start[i].op == OP_CUR) {
+      i += (size_t)code->start[i].arg - 1;
+    }
+  }
+  fprintf(me->out, "}\n");
+}
+
+static bool
+Inline(const opcode_t op)
+{
+  switch (op) {
+  case OP_FST:
+  case OP_SND:
+  case OP_ACC:
+  case OP_QUOTE:
+  case OP_PLUS:
+  case OP_RET:
+  case OP_HALT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool
+Projects(const code_t * const code, const size_t start, const size_t end)
+{
+  size_t  i;
+
+  for (i = start; i < end; ++i) {
+    switch (code->start[i].op) {
+    case OP_FST:
+    case OP_SND:
+    case OP_ACC:
+    case OP_PLUS:
+      return true;
+    case OP_CUR:
+      i += (size_t)code->start[i].arg - 1;
+      break;
+    default:
+      break;
+    }
+  }
+  return false;
+}
+
+static void
+Translate(aot_t * const me, const instr_t * const ip, const size_t k,
+          const size_t i)
+{
+  FILE * const  out = me->out;
+  int           n;
+
+  fprintf(out, "  /* %zu: %s %d */\n", i, NAMES[ip->op], ip->arg);
+  switch (ip->op) {
+  case OP_FST:
+  case OP_SND:
+  case OP_ACC:
+    fprintf(out, "  proj = Env_Retain(env->");
+    for (n = ip->op == OP_ACC ? ip->arg : 0; n > 0; --n) {
+      fprintf(out, "u.pair.fst->");
+    }
+    fprintf(out, "u.pair.%s);\n", ip->op == OP_FST ? "fst" : "snd");
+    fprintf(out, "  Env_Free(cam->ctx, &env);\n"
+                 "  env = proj;\n");
+    break;
+  case OP_QUOTE:
+    fprintf(out, "  Env_Free(cam->ctx, &env);\n"
+                 "  env = Env_Int(cam->ctx, %d);\n", ip->arg);
+    break;
+  case OP_PLUS:
+    fprintf(out, "  proj = Env_Int(cam->ctx,\n"
+                 "      (int)((unsigned int)Env_Num(env->u.pair.fst)\n"
+                 "            + (unsigned int)Env_Num(env->u.pair.snd)));\n"
+                 "  Env_Free(cam->ctx, &env);\n"
+                 "  env = proj;\n");
+    break;
+  case OP_APP:
+  case OP_TAPP:
+    fprintf(out, "  cam->env = env;\n"
+                 "  Apply_%zu(cam, Cam_Step(cam, &code_%zu[%zu]));\n", k, k, i);
+    fprintf(out, ip->op == OP_APP ? "  env = cam->env;\n" : "  return;\n");
+    break;
+  case OP_RET:
+  case OP_HALT:
+    fprintf(out, "  cam->env = env;\n");
+    break;
+  default:
+    fprintf(out, "  cam->env = env;\n"
+                 "  Cam_Step(cam, &code_%zu[%zu]);\n"
+                 "  env = cam->env;\n", k, i);
+    break;
+  }
+}
+
+bool
+Aot_Finish(aot_t * const me)
+{
+  size_t  k;
+
+  assert(me);
+
+  fprintf(me->out, "\nint\n"
+                   "main(void)\n"
+                   "{\n");
+  if (me->nterms > 0) {
+    fprintf(me->out, "  static int (* const terms[])(cam_context_t * const) "
+                     "= {\n");
+    for (k = 0; k < me->nterms; ++k) {
+      fprintf(me->out, "    Term_%zu,\n", k);
+    }
+    fprintf(me->out, "  };\n"
+                     "  cam_context_t ctx;\n"
+                     "  size_t        i;\n\n"
+                     "  Context_Init(&ctx);\n"
+                     "  for (i = 0; i < sizeof(terms) / sizeof(terms[0]); "
+                     "++i) {\n"
+                     "    TRY(ctx.handler)\n"
+                     "      printf(\"%%d\\n\", terms[i](&ctx));\n"
+                     "    CATCH\n"
+                     "      Context_Reset(&ctx);\n"
+                     "    END\n"
+                     "  }\n"
+                     "  Context_Free(&ctx);\n");
+  }
+  fprintf(me->out, "  return 0;\n"
+                   "}\n");
+  return fflush(me->out) == 0 && !ferror(me->out);
+}
+
@@ -0,0 +1,20 @@
+#ifndef AOT_H_
+#define AOT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "code.h"
+
+typedef struct {
+  FILE *  out;
+  size_t  nterms;
+} aot_t;
+
+extern void Aot_Init(aot_t * const, FILE * const);
+extern void Aot_Term(aot_t * const, const code_t * const);
+extern bool Aot_Finish(aot_t * const);
+
+#endif /* AOT_H_ */
+
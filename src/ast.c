@@ -1,19 +1,49 @@
 #include "ast.h"
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 
+#include "except.h"
 #include "pool.h"
 
-static ast_t  g_pool[N_ELEMS];
-pool_t        g_ast_pool = INIT_POOL(g_pool, N_ELEMS, ast_t);
+enum {
+  N_FRAMES = 256
+};
+
+enum {
+  N_NODES = 1024
+};
+
+typedef struct frame_s {
+  const ast_t * parent;
+  const ast_t * child;
+} frame_t;
+
+typedef struct {
+  visit_t         base;
+  cam_context_t * ctx;
+  uint32_t        len;
+  uint32_t        open;
+} pack_t;
+
+static void Enter(cam_context_t * const, const ast_t * const, visit_t * const);
+static void Leave(const ast_t * const, visit_t * const);
+
+static statusCode_t PackNode(pack_t * const, const ast_t *);
+static statusCode_t PackParent(pack_t * const, const ast_t *);
+static statusCode_t PackClose(pack_t * const, const ast_t *);
+static void *       Resize(cam_context_t * const, void * const, const size_t);
 
 ast_t *
-Ast_New(const astType_t type, int cnt, ...)
+Ast_New(cam_context_t * const ctx, const astType_t type, int cnt, ...)
 {
   ast_t * me;
   va_list argp;
 
-  me = Pool_Calloc(&g_ast_pool);
+  me = Pool_Alloc(&ctx->ast_pool);
+  me->rchild = NULL;
+  me->value = 0;
   me->type = type;
 
   va_start(argp, cnt);
@@ -26,20 +56,33 @@ Ast_New(const astType_t type, int cnt, ...)
 }
 
 ast_t *
-Ast_Quote(const int value)
+Ast_Quote(cam_context_t * const ctx, const int value)
 {
   ast_t * me;
 
-  me = Pool_Calloc(&g_ast_pool);
+  me = Pool_Alloc(&ctx->ast_pool);
+  me->rchild = NULL;
   me->type = AST_QUOTE;
   me->value = value;
   return me;
 }
 
 ast_t *
-Ast_Plus(void)
+Ast_Acc(cam_context_t * const ctx, const int n)
+{
+  ast_t * me;
+
+  assert(n >= 0);
+
+  me = Ast_Node(ctx, AST_ACC);
+  me->value = n;
+  return me;
+}
+
+ast_t *
+Ast_Plus(cam_context_t * const ctx)
 {
-  return Ast_Cur(Ast_Comp(2, Ast_Snd(), Ast_Node(AST_PLUS)));
+  return Ast_Cur(ctx, Ast_Comp(ctx, 2, Ast_Snd(ctx), Ast_Node(ctx, AST_PLUS)));
 }
 
 static node_t *
@@ -58,14 +101,17 @@ Flatten(ast_t *me)
 }
 
 void
-Ast_Free(ast_t ** const me)
+Ast_Free(cam_context_t * const ctx, ast_t ** const me)
 {
   assert(me);
 
   if (*me == NULL) {
     return;
   }
-  Pool_FreeList(&g_ast_pool, Flatten(*me));
+#if defined(CAM_STATS)
+  ++ctx->counters.flattens;
+#endif
+  Pool_FreeList(&ctx->ast_pool, Flatten(*me));
   *me = NULL;
 }
 
@@ -76,27 +122,66 @@ Visit(const ast_t * const me, visit_t * const vp, const size_t offset)
 }
 
 void
-Ast_Traverse(const ast_t * const me, visit_t * const vp)
+Ast_Traverse(cam_context_t * const ctx, const ast_t * const me,
+             visit_t * const vp)
 {
-  ast_t *       ap;
-  statusCode_t  sc;
+  const size_t  base = ctx->depth;
+  const ast_t * parent;
+  const ast_t * ap;
 
   assert(me);
   assert(vp);
 
-  sc = Visit(me, vp, me->type);
+  Enter(ctx, me, vp);
+  while (ctx->depth > base) {
+    parent = ctx->frames[ctx->depth - 1].parent;
+    ap = ctx->frames[ctx->depth - 1].child;
+    if (ap == NULL) {
+      ap = Link(parent->rchild);
+    } else {
+      if (parent->type == AST_PAIR && ap == Link(parent->rchild)) {
+        Visit(parent, vp, 10); /* InVisitPair */
+      }
+      if (ap == parent->rchild) {
+        --ctx->depth;
+        Leave(parent, vp);
+        continue;
+      }
+      ap = Link(ap);
+    }
+    ctx->frames[ctx->depth - 1].child = ap;
+    Enter(ctx, ap, vp);
+  }
+}
+
+static void
+Enter(cam_context_t * const ctx, const ast_t * const me, visit_t * const vp)
+{
+  const statusCode_t sc = Visit(me, vp, me->type);
 
   if (sc == SC_CONTINUE && (me->rchild)) {
-    ap = Link(me->rchild);
-    Ast_Traverse(ap, vp);
-    if (me->type == AST_PAIR) {
-      Visit(me, vp, 9); /* InVisitPair */
-    }
-    while ((ap = Link(ap)) != Link(me->rchild)) {
-      Ast_Traverse(ap, vp);
+    if (ctx->depth == ctx->frames_capacity) {
+      frame_t * fp;
+      size_t    cnt;
+
+      cnt = ctx->frames_capacity ? 2 * ctx->frames_capacity : N_FRAMES;
+      if (!(fp = realloc(ctx->frames, cnt * sizeof(frame_t)))) {
+        fprintf(stderr, "Out of memory.\n");
+        THROW(ctx->handler);
+      }
+      ctx->frames = fp;
+      ctx->frames_capacity = cnt;
     }
+    ctx->frames[ctx->depth].parent = me;
+    ctx->frames[ctx->depth++].child = NULL;
+  } else {
+    Leave(me, vp);
   }
+}
 
+static void
+Leave(const ast_t * const me, visit_t * const vp)
+{
   if (me->type == AST_CUR || me->type == AST_COMP 
       || me->type == AST_PAIR) {
     Visit(me, vp, me->type + 4);
@@ -111,3 +196,109 @@ VisitDefault(visit_t * const me, const ast_t *ap)
   return SC_CONTINUE;
 }
 
+void
+Ast_Pack(cam_context_t * const ctx, const ast_t * const ap,
+         tree_t * const tree)
+{
+  static const visitVtbl_t vtbl = {
+    (visitFunc_t) PackNode,       /* VisitId */
+    (visitFunc_t) PackNode,       /* VisitApp */
+    (visitFunc_t) PackNode,       /* VisitQuote */
+    (visitFunc_t) PackNode,       /* VisitPlus */
+    (visitFunc_t) PackNode,       /* VisitFst */
+    (visitFunc_t) PackNode,       /* VisitSnd */
+    (visitFunc_t) PackNode,       /* VisitAcc */
+    (visitFunc_t) PackParent,     /* PreVisitComp */
+    (visitFunc_t) PackParent,     /* PreVisitPair */
+    (visitFunc_t) PackParent,     /* PreVisitCur */
+                  VisitDefault,   /* InVisitPair */
+    (visitFunc_t) PackClose,      /* PostVisitComp */
+    (visitFunc_t) PackClose,      /* PostVisitPair */
+    (visitFunc_t) PackClose       /* PostVisitCur */
+  };
+  pack_t  pack;
+
+  assert(ctx);
+  assert(ap);
+  assert(tree);
+
+  pack.base.vptr = &vtbl;
+  pack.ctx = ctx;
+  pack.len = 0;
+  pack.open = 0;
+  Ast_Traverse(ctx, ap, (visit_t *)&pack);
+  assert(pack.open == 0);
+
+  tree->types = ctx->types;
+  tree->values = ctx->values;
+  tree->counts = ctx->counts;
+  tree->sizes = ctx->sizes;
+  tree->len = pack.len;
+}
+
+static statusCode_t
+PackNode(pack_t * const me, const ast_t *ap)
+{
+  cam_context_t * const ctx = me->ctx;
+  const ast_t *         it;
+  uint32_t              cnt = 0;
+
+  if (me->len == ctx->nodes_capacity) {
+    const size_t  cnt = ctx->nodes_capacity ? 2 * ctx->nodes_capacity : N_NODES;
+
+    if (cnt > UINT32_MAX) {
+      fprintf(stderr, "Out of memory.\n");
+      THROW(ctx->handler);
+    }
+    ctx->types = Resize(ctx, ctx->types, cnt * sizeof(unsigned char));
+    ctx->values = Resize(ctx, ctx->values, cnt * sizeof(int));
+    ctx->counts = Resize(ctx, ctx->counts, cnt * sizeof(uint32_t));
+    ctx->sizes = Resize(ctx, ctx->sizes, cnt * sizeof(uint32_t));
+    ctx->nodes_capacity = cnt;
+  }
+  if ((it = ap->rchild)) {
+    do {
+      ++cnt;
+    } while ((it = Link(it)) != ap->rchild);
+  }
+  ctx->types[me->len] = (unsigned char)ap->type;
+  ctx->values[me->len] = ap->value;
+  ctx->counts[me->len] = cnt;
+  ctx->sizes[me->len++] = 1;
+  return SC_CONTINUE;
+}
+
+static statusCode_t
+PackParent(pack_t * const me, const ast_t *ap)
+{
+  PackNode(me, ap);
+  me->ctx->sizes[me->len - 1] = me->open;
+  me->open = me->len;
+  return SC_CONTINUE;
+}
+
+static statusCode_t
+PackClose(pack_t * const me, const ast_t *ap)
+{
+  const uint32_t  i = me->open - 1;
+
+  (void)ap;
+  assert(me->open > 0);
+
+  me->open = me->ctx->sizes[i];
+  me->ctx->sizes[i] = me->len - i;
+  return SC_CONTINUE;
+}
+
+static void *
+Resize(cam_context_t * const ctx, void * const buff, const size_t size)
+{
+  void *  ptr;
+
+  if (!(ptr = realloc(buff, size))) {
+    fprintf(stderr, "Out of memory.\n");
+    THROW(ctx->handler);
+  }
+  return ptr;
+}
+
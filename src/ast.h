@@ -3,18 +3,20 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 
+#include "context.h"
 #include "node.h"
 
-#define Ast_Id()               Ast_New(AST_ID, 0)
-#define Ast_Fst()              Ast_New(AST_FST, 0)
-#define Ast_Snd()              Ast_New(AST_SND, 0)
-#define Ast_App()              Ast_New(AST_APP, 0)
-#define Ast_Cur(child)         Ast_New(AST_CUR, 1, (child))
-#define Ast_Pair(left, right)  Ast_New(AST_PAIR,2,(left),(right))
-#define Ast_Comp(cnt, ...)     Ast_New(AST_COMP,(cnt),__VA_ARGS__)
+#define Ast_Id(cx)              Ast_New((cx), AST_ID, 0)
+#define Ast_Fst(cx)             Ast_New((cx), AST_FST, 0)
+#define Ast_Snd(cx)             Ast_New((cx), AST_SND, 0)
+#define Ast_App(cx)             Ast_New((cx), AST_APP, 0)
+#define Ast_Cur(cx, child)      Ast_New((cx), AST_CUR, 1, (child))
+#define Ast_Pair(cx, l, r)      Ast_New((cx), AST_PAIR, 2, (l), (r))
+#define Ast_Comp(cx, cnt, ...)  Ast_New((cx), AST_COMP, (cnt), __VA_ARGS__)
 
-#define Ast_Node(type)               Ast_New((type), 0)
+#define Ast_Node(cx, type)           Ast_New((cx), (type), 0)
 #define Ast_AddChild(me,child)       Push(&(me)->rchild,(child))
 #define Ast_SetChildren(me,children) (me)->rchild = (children)
 
@@ -27,6 +29,7 @@ typedef enum {
   AST_PLUS,
   AST_FST,
   AST_SND,
+  AST_ACC,
   AST_COMP,
   AST_PAIR,
   AST_CUR
@@ -49,6 +52,7 @@ typedef struct {
   visitFunc_t   VisitPlus;
   visitFunc_t   VisitFst;
   visitFunc_t   VisitSnd;
+  visitFunc_t   VisitAcc;
   visitFunc_t   PreVisitComp;
   visitFunc_t   PreVisitPair;
   visitFunc_t   PreVisitCur;
@@ -58,6 +62,14 @@ typedef struct {
   visitFunc_t   PostVisitCur;
 } visitVtbl_t;
 
+typedef struct {
+  const unsigned char * types;
+  const int *           values;
+  const uint32_t *      counts;
+  const uint32_t *      sizes;
+  uint32_t              len;
+} tree_t;
+
 struct ast_s {
   node_t    base;
   ast_t *   rchild;
@@ -69,13 +81,17 @@ struct visit_s {
   const visitVtbl_t * vptr;
 };
 
-extern ast_t * Ast_New(const astType_t, int, ...);
-extern ast_t * Ast_Quote(const int);
-extern ast_t * Ast_Plus(void);
-extern void    Ast_Free(ast_t ** const);
-extern void    Ast_Traverse(const ast_t * const, visit_t * const);
+extern ast_t * Ast_New(cam_context_t * const, const astType_t, int, ...);
+extern ast_t * Ast_Quote(cam_context_t * const, const int);
+extern ast_t * Ast_Acc(cam_context_t * const, const int);
+extern ast_t * Ast_Plus(cam_context_t * const);
+extern void    Ast_Free(cam_context_t * const, ast_t ** const);
+extern void    Ast_Traverse(cam_context_t * const, const ast_t * const,
+                            visit_t * const);
 
 extern statusCode_t VisitDefault(visit_t * const, const ast_t *);
+extern void    Ast_Pack(cam_context_t * const, const ast_t * const,
+                        tree_t * const);
 
 #endif /* AST_H_ */
 
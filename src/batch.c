@@ -0,0 +1,271 @@
+#include "batch.h"
+
+#include <pthread.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  N_TASKS = 4096
+};
+
+typedef struct {
+  size_t  offset;
+  size_t  len;
+  int     result;
+  bool    ok;
+} task_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  size_t          front;
+  size_t          back;
+} deque_t;
+
+static task_t *         g_tasks = NULL;
+static char *           g_text = NULL;
+static size_t           g_text_capacity = 0;
+static const char *     g_base = NULL;
+static deque_t *        g_deques = NULL;
+static cam_context_t *  g_contexts = NULL;
+static size_t           g_jobs = 0;
+static evalFunc_t       g_eval = NULL;
+
+static pthread_mutex_t  g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   g_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   g_done = PTHREAD_COND_INITIALIZER;
+static unsigned long    g_round = 0;
+static size_t           g_busy = 0;
+static bool             g_quit = false;
+
+static void *   Worker(void *);
+static void     Work(const size_t);
+static size_t   Read(reader_t * const, bool * const);
+static void     Dispatch(const size_t);
+
+int
+Batch_Run(const size_t jobs, evalFunc_t eval, reader_t * const in,
+          writer_t * const out)
+{
+  pthread_t * threads;
+  size_t      i;
+  size_t      cnt;
+  size_t      started = 0;
+  bool        halt = false;
+  int         status = 1;
+
+  assert(jobs > 0);
+  assert(eval);
+  assert(in);
+  assert(out);
+
+  g_jobs = jobs;
+  g_eval = eval;
+  g_tasks = malloc(N_TASKS * sizeof(task_t));
+  g_deques = malloc(jobs * sizeof(deque_t));
+  g_contexts = malloc(jobs * sizeof(cam_context_t));
+  threads = malloc(jobs * sizeof(pthread_t));
+  if (!g_tasks || !g_deques || !g_contexts || !threads) {
+    fprintf(stderr, "Out of memory.\n");
+    goto cleanup;
+  }
+  for (i = 0; i < jobs; ++i) {
+    pthread_mutex_init(&g_deques[i].lock, NULL);
+    g_deques[i].front = g_deques[i].back = 0;
+    Context_Init(&g_contexts[i]);
+  }
+
+  for (started = 1; started < jobs; ++started) {
+    if (pthread_create(&threads[started], NULL, Worker, &g_deques[started])) {
+      fprintf(stderr, "Unable to start thread.\n");
+      goto cleanup;
+    }
+  }
+
+  do {
+    cnt = Read(in, &halt);
+    Dispatch(cnt);
+    for (i = 0; i < cnt; ++i) {
+      if (g_tasks[i].ok) {
+        Writer_Int(out, g_tasks[i].result);
+        Writer_Char(out, '\n');
+      }
+    }
+  } while (!halt && cnt == N_TASKS);
+  status = 0;
+cleanup:
+  pthread_mutex_lock(&g_lock);
+  g_quit = true;
+  pthread_cond_broadcast(&g_start);
+  pthread_mutex_unlock(&g_lock);
+  for (i = 1; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  if (g_tasks && g_deques && g_contexts && threads) {
+    for (i = 0; i < jobs; ++i) {
+      Context_Free(&g_contexts[i]);
+    }
+  }
+  free(threads);
+  free(g_contexts);
+  free(g_deques);
+  free(g_tasks);
+  free(g_text);
+  g_text = NULL;
+  g_text_capacity = 0;
+  g_base = NULL;
+  g_contexts = NULL;
+  g_deques = NULL;
+  g_tasks = NULL;
+
+  return status;
+}
+
+static size_t
+Read(reader_t * const in, bool * const halt)
+{
+  const char *  term;
+  char *        cp;
+  size_t        len;
+  size_t        offset = 0;
+  size_t        cnt = 0;
+
+  while (cnt < N_TASKS) {
+    term = Reader_Next(in, &len);
+    if (!term || (len == 4 && memcmp("halt", term, 4) == 0)) {
+      *halt = true;
+      break;
+    }
+    if (in->mapped) {
+      g_tasks[cnt].offset = (size_t)(term - in->buff);
+    } else {
+      if (offset + len > g_text_capacity) {
+        if (!(cp = realloc(g_text, 2 * (offset + len)))) {
+          fprintf(stderr, "Out of memory.\n");
+          *halt = true;
+          break;
+        }
+        g_text = cp;
+        g_text_capacity = 2 * (offset + len);
+      }
+      memcpy(g_text + offset, term, len);
+      g_tasks[cnt].offset = offset;
+      offset += len;
+    }
+    g_tasks[cnt].len = len;
+    g_tasks[cnt].ok = false;
+    ++cnt;
+  }
+  g_base = in->mapped ? in->buff : g_text;
+  return cnt;
+}
+
+static void
+Dispatch(const size_t cnt)
+{
+  size_t  i;
+
+  for (i = 0; i < g_jobs; ++i) {
+    g_deques[i].front = i * cnt / g_jobs;
+    g_deques[i].back = (i + 1) * cnt / g_jobs;
+  }
+  pthread_mutex_lock(&g_lock);
+  g_busy = g_jobs - 1;
+  ++g_round;
+  pthread_cond_broadcast(&g_start);
+  pthread_mutex_unlock(&g_lock);
+
+  Work(0);
+
+  pthread_mutex_lock(&g_lock);
+  while (g_busy > 0) {
+    pthread_cond_wait(&g_done, &g_lock);
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void *
+Worker(void *arg)
+{
+  const size_t    id = (size_t)((deque_t *)arg - g_deques);
+  unsigned long   round = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&g_lock);
+    while (g_round == round && !g_quit) {
+      pthread_cond_wait(&g_start, &g_lock);
+    }
+    if (g_quit) {
+      pthread_mutex_unlock(&g_lock);
+      return NULL;
+    }
+    round = g_round;
+    pthread_mutex_unlock(&g_lock);
+
+    Work(id);
+
+    pthread_mutex_lock(&g_lock);
+    if (--g_busy == 0) {
+      pthread_cond_signal(&g_done);
+    }
+    pthread_mutex_unlock(&g_lock);
+  }
+}
+
+static bool
+TakeFront(deque_t * const me, size_t * const ip)
+{
+  bool  found;
+
+  pthread_mutex_lock(&me->lock);
+  if ((found = me->front < me->back)) {
+    *ip = me->front++;
+  }
+  pthread_mutex_unlock(&me->lock);
+  return found;
+}
+
+static bool
+TakeBack(deque_t * const me, size_t * const ip)
+{
+  bool  found;
+
+  pthread_mutex_lock(&me->lock);
+  if ((found = me->front < me->back)) {
+    *ip = --me->back;
+  }
+  pthread_mutex_unlock(&me->lock);
+  return found;
+}
+
+static bool
+Take(const size_t id, size_t * const ip)
+{
+  size_t  i;
+
+  if (TakeFront(&g_deques[id], ip)) {
+    return true;
+  }
+  for (i = 1; i < g_jobs; ++i) {
+    if (TakeBack(&g_deques[(id + i) % g_jobs], ip)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void
+Work(const size_t id)
+{
+  task_t *  tp;
+  size_t    i;
+
+  while (Take(id, &i)) {
+    tp = &g_tasks[i];
+    tp->ok = g_eval(&g_contexts[id], g_base + tp->offset, tp->len,
+                    &tp->result);
+  }
+}
+
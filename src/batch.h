@@ -0,0 +1,17 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "context.h"
+#include "stream.h"
+
+typedef bool (*evalFunc_t)(cam_context_t * const, const char * const,
+                           const size_t, int * const);
+
+extern int  Batch_Run(const size_t, evalFunc_t, reader_t * const,
+                      writer_t * const);
+
+#endif /* BATCH_H_ */
+
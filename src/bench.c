@@ -0,0 +1,386 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ast.h"
+#include "cam.h"
+#include "code.h"
+#include "context.h"
+#include "except.h"
+#include "lexer.h"
+#include "optim.h"
+#include "parser.h"
+
+typedef struct {
+  char *  start;
+  size_t  len;
+  size_t  capacity;
+} text_t;
+
+typedef struct {
+  const char *  name;
+  void          (*Generate)(text_t * const, const size_t);
+} family_t;
+
+typedef enum {
+  PHASE_LEX,
+  PHASE_PARSE,
+  PHASE_COMPILE0,
+  PHASE_RUN0,
+  PHASE_OPTIM,
+  PHASE_COMPILE,
+  PHASE_RUN,
+  N_PHASES
+} phase_t;
+
+typedef struct {
+  uint64_t  ns[N_PHASES];
+  uint64_t  units[N_PHASES];
+  uint64_t  bytes;
+  uint64_t  reps;
+} timing_t;
+
+static void Sum(text_t * const, const size_t);
+static void Nest(text_t * const, const size_t);
+static void Args(text_t * const, const size_t);
+static void Deep(text_t * const, const size_t);
+
+static void Report(const family_t * const, const size_t, const phase_t,
+                   const timing_t * const);
+
+enum {
+  N_TEXT = 256
+};
+
+static const char LETTERS[] = "abcdefghijklmnopqrstuwxyz";
+
+static const family_t FAMILIES[] = {
+  { "sum", Sum },
+  { "nest", Nest },
+  { "args", Args },
+  { "deep", Deep }
+};
+
+enum {
+  N_FAMILIES = sizeof(FAMILIES) / sizeof(FAMILIES[0])
+};
+
+static const char * const PHASES[] = {
+  "lex", "lex+parse", "compile0", "run0", "optim", "compile", "run"
+};
+
+enum {
+  N_BYTES = 1 << 21
+};
+
+static const size_t SIZES[] = { 10, 100, 1000 };
+
+enum {
+  N_SIZES = sizeof(SIZES) / sizeof(SIZES[0])
+};
+
+static void
+Put(text_t * const me, const char * const fmt, ...)
+{
+  va_list ap;
+  size_t  cnt;
+  int     len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(me->start + me->len, me->capacity - me->len, fmt, ap);
+  va_end(ap);
+  if (len >= 0 && me->len + (size_t)len >= me->capacity) {
+    for (cnt = me->capacity; cnt <= me->len + (size_t)len; cnt *= 2) {
+      continue;
+    }
+    if (!(me->start = realloc(me->start, cnt))) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+    }
+    me->capacity = cnt;
+    va_start(ap, fmt);
+    len = vsnprintf(me->start + me->len, me->capacity - me->len, fmt, ap);
+    va_end(ap);
+  }
+  if (len < 0) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+  me->len += (size_t)len;
+}
+
+static void
+Text_Init(text_t * const me)
+{
+  if (!(me->start = malloc(N_TEXT))) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+  me->len = 0;
+  me->capacity = N_TEXT;
+}
+
+static void
+Name(text_t * const me, size_t i)
+{
+  char    name[32];
+  size_t  pos = sizeof(name) - 1;
+
+  name[pos] = '\0';
+  do {
+    name[--pos] = LETTERS[i % (sizeof(LETTERS) - 1)];
+    i /= sizeof(LETTERS) - 1;
+  } while (i > 0);
+  Put(me, "z%s", name + pos);
+}
+
+static void
+Sum(text_t * const me, const size_t n)
+{
+  size_t  i;
+
+  Put(me, n > 1 ? "(+" : "");
+  for (i = 0; i < n; ++i) {
+    Put(me, n > 1 ? " %d" : "%d", (int)(i % 10));
+  }
+  Put(me, n > 1 ? ")" : "");
+}
+
+static void
+Nest(text_t * const me, const size_t n)
+{
+  size_t  i;
+
+  for (i = 0; i < n; ++i) {
+    Put(me, "((lambda (x) ");
+  }
+  Put(me, "x");
+  for (i = 1; i < n; ++i) {
+    Put(me, ") (+ x 1))");
+  }
+  Put(me, ") 0)");
+}
+
+static void
+Args(text_t * const me, const size_t n)
+{
+  size_t  i;
+
+  Put(me, "((lambda (");
+  for (i = 0; i < n; ++i) {
+    Put(me, i > 0 ? " " : "");
+    Name(me, i);
+  }
+  Put(me, n > 1 ? ") (+" : ") ");
+  for (i = 0; i < n; ++i) {
+    Put(me, n > 1 ? " " : "");
+    Name(me, i);
+  }
+  Put(me, n > 1 ? "))" : ")");
+  for (i = 0; i < n; ++i) {
+    Put(me, " %d", (int)(i % 10));
+  }
+  Put(me, ")");
+}
+
+static void
+Deep(text_t * const me, const size_t n)
+{
+  size_t  i;
+
+  for (i = 0; i < n; ++i) {
+    Put(me, "((lambda (");
+    Name(me, i);
+    Put(me, ") ");
+  }
+  Name(me, 0);
+  for (i = n; i > 0; --i) {
+    Put(me, ") %d)", (int)(i % 10));
+  }
+}
+
+static uint64_t
+Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void
+Repeat(cam_context_t * const ctx, const text_t * const text,
+       timing_t * const timing)
+{
+  ast_t *   ap;
+  cam_t     cam;
+  code_t    code;
+  lexer_t   lexer;
+  optim_t   optim;
+  tree_t    tree;
+  uint64_t  t[N_PHASES + 1];
+  uint64_t  units[N_PHASES];
+  uint64_t  ntokens = 0;
+  size_t    i = 0;
+
+  t[0] = Now();
+  Lexer_Init(&lexer, ctx, text->start, text->len);
+  while (Lexer_NextToken(&lexer) > 0) {
+    ++ntokens;
+  }
+  units[i] = ntokens;
+  t[++i] = Now();
+
+  Lexer_Init(&lexer, ctx, text->start, text->len);
+  ap = Parse(ctx, &lexer);
+  t[++i] = Now();
+
+  Ast_Pack(ctx, ap, &tree);
+  Code_Compile(&code, ctx, &tree);
+  units[i] = code.len;
+  t[++i] = Now();
+
+  Cam_Init(&cam, ctx);
+  Cam_Run(&cam, &code);
+  Cam_Free(&cam);
+  units[i] = code.len;
+  t[++i] = Now();
+
+  units[PHASE_PARSE] = units[i] = tree.len;
+  Optim_Init(&optim, ctx);
+  Ast_Traverse(ctx, ap, (visit_t *)&optim);
+  t[++i] = Now();
+
+  Ast_Pack(ctx, ap, &tree);
+  Code_Compile(&code, ctx, &tree);
+  units[i] = code.len;
+  t[++i] = Now();
+
+  Cam_Init(&cam, ctx);
+  Cam_Run(&cam, &code);
+  Cam_Free(&cam);
+  units[i] = code.len;
+  t[++i] = Now();
+
+  Ast_Free(ctx, &ap);
+  assert(i == N_PHASES);
+  for (i = 0; i < N_PHASES; ++i) {
+    timing->ns[i] += t[i + 1] - t[i];
+    timing->units[i] += units[i];
+  }
+  timing->bytes += text->len;
+  ++timing->reps;
+}
+
+static bool
+Measure(cam_context_t * const ctx, const family_t * const family,
+        const size_t n, text_t * const text)
+{
+  timing_t  timing;
+  size_t    i;
+  bool      ok = false;
+
+  memset(&timing, 0, sizeof(timing));
+  text->len = 0;
+  family->Generate(text, n);
+  TRY(ctx->handler)
+    do {
+      Repeat(ctx, text, &timing);
+    } while (timing.bytes < N_BYTES);
+    for (i = 0; i < N_PHASES; ++i) {
+      Report(family, n, (phase_t)i, &timing);
+    }
+    ok = true;
+  CATCH
+    fprintf(stderr, "Cannot time %s at size %zu.\n", family->name, n);
+    Context_Reset(ctx);
+  END
+  return ok;
+}
+
+static void
+Report(const family_t * const family, const size_t n, const phase_t phase,
+       const timing_t * const timing)
+{
+  const double  ns = (double)timing->ns[phase];
+  const double  units = (double)timing->units[phase];
+
+  printf("%-6s %8zu  %-9s %10llu %10.2f %10.2f\n", family->name, n,
+         PHASES[phase],
+         (unsigned long long)(timing->units[phase] / timing->reps),
+         units > 0 ? ns / units : 0.0,
+         ns > 0 ? 1e3 * (double)timing->bytes / ns : 0.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  cam_context_t     ctx;
+  text_t            text;
+  const family_t *  family = NULL;
+  char *            cp;
+  long              n = 0;
+  int               i = 1;
+  bool              print = false;
+  bool              ok = true;
+  size_t            j;
+  size_t            k;
+
+  if (i < argc && strcmp(argv[i], "--print") == 0) {
+    print = true;
+    ++i;
+  }
+  if (i < argc) {
+    for (j = 0; j < N_FAMILIES; ++j) {
+      if (strcmp(argv[i], FAMILIES[j].name) == 0) {
+        family = &FAMILIES[j];
+      }
+    }
+    if (!family) {
+      goto usage;
+    }
+    ++i;
+  }
+  if (i < argc) {
+    n = strtol(argv[i++], &cp, 10);
+    if (*cp != '\0' || n < 1) {
+      goto usage;
+    }
+  }
+  if (i < argc || (print && !n)) {
+    goto usage;
+  }
+  Text_Init(&text);
+  if (print) {
+    family->Generate(&text, (size_t)n);
+    printf("%s\n", text.start);
+  } else {
+    Context_Init(&ctx);
+    printf("%-6s %8s  %-9s %10s %10s %10s\n", "family", "size", "phase",
+           "units", "ns/unit", "MB/s");
+    for (j = 0; j < N_FAMILIES; ++j) {
+      if (family && family != &FAMILIES[j]) {
+        continue;
+      }
+      for (k = 0; k < (n ? 1 : N_SIZES); ++k) {
+        ok = Measure(&ctx, &FAMILIES[j], n ? (size_t)n : SIZES[k], &text)
+             && ok;
+      }
+    }
+    Context_Free(&ctx);
+  }
+  free(text.start);
+  return ok ? 0 : 1;
+usage:
+  fprintf(stderr, "Usage: %s [--print] [sum|nest|args|deep [SIZE]]\n",
+          argv[0]);
+  return 1;
+}
+
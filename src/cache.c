@@ -0,0 +1,254 @@
+#include "cache.h"
+
+#include <pthread.h>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "context.h"
+#include "except.h"
+
+enum {
+  BYTES_PER_BUCKET = 256,
+  N_KEY = 256
+};
+
+typedef struct entry_s {
+  struct entry_s *  chain;
+  struct entry_s *  prev;
+  struct entry_s *  next;
+  uint64_t          hash;
+  size_t            size;
+  int               result;
+  unsigned char     key[];
+} entry_t;
+
+static void     MakeKey(cam_context_t * const, const tree_t * const);
+static uint64_t Hash(const unsigned char *, const size_t);
+static entry_t *Lookup(cache_t * const, const uint64_t,
+                       const unsigned char * const, const size_t);
+static void     Front(cache_t * const, entry_t * const);
+static void     Unlink(cache_t * const, entry_t * const);
+static void     Remove(cache_t * const, entry_t * const);
+
+bool
+Cache_Init(cache_t * const me, const size_t capacity)
+{
+  size_t  n = 1;
+
+  assert(me);
+
+  while (2 * n <= capacity / BYTES_PER_BUCKET) {
+    n *= 2;
+  }
+  if (!(me->buckets = calloc(n, sizeof(entry_t *)))) {
+    return false;
+  }
+  pthread_mutex_init(&me->lock, NULL);
+  me->nbuckets = n;
+  me->mru = NULL;
+  me->nentries = 0;
+  me->size = n * sizeof(entry_t *);
+  me->capacity = capacity;
+  me->hits = me->misses = 0;
+  return true;
+}
+
+void
+Cache_Free(cache_t * const me)
+{
+  entry_t * ep;
+
+  assert(me);
+
+  while ((ep = me->mru)) {
+    Remove(me, ep);
+    free(ep);
+  }
+  free(me->buckets);
+  pthread_mutex_destroy(&me->lock);
+}
+
+bool
+Cache_Find(cache_t * const me, cam_context_t * const ctx,
+           const tree_t * const tree, int * const result)
+{
+  entry_t * ep;
+
+  assert(me);
+  assert(ctx);
+  assert(tree);
+  assert(result);
+
+  MakeKey(ctx, tree);
+  pthread_mutex_lock(&me->lock);
+  if ((ep = Lookup(me, ctx->key_hash, ctx->key, ctx->key_size))) {
+    Unlink(me, ep);
+    Front(me, ep);
+    *result = ep->result;
+    ++me->hits;
+  } else {
+    ++me->misses;
+  }
+  pthread_mutex_unlock(&me->lock);
+  return ep != NULL;
+}
+
+static void
+MakeKey(cam_context_t * const ctx, const tree_t * const tree)
+{
+  const size_t    values = tree->len * sizeof(int);
+  const size_t    counts = tree->len * sizeof(uint32_t);
+  const size_t    size = tree->len + values + counts;
+  size_t          cnt = ctx->key_capacity ? ctx->key_capacity : N_KEY;
+  unsigned char * kp;
+
+  if (size > ctx->key_capacity) {
+    while (cnt < size) {
+      cnt *= 2;
+    }
+    if (!(kp = realloc(ctx->key, cnt))) {
+      fprintf(stderr, "Out of memory.\n");
+      THROW(ctx->handler);
+    }
+    ctx->key = kp;
+    ctx->key_capacity = cnt;
+  }
+  memcpy(ctx->key, tree->types, tree->len);
+  memcpy(ctx->key + tree->len, tree->values, values);
+  memcpy(ctx->key + tree->len + values, tree->counts, counts);
+  ctx->key_size = size;
+  ctx->key_hash = Hash(ctx->key, size);
+}
+
+static uint64_t
+Hash(const unsigned char *kp, const size_t size)
+{
+  uint64_t  hash = 14695981039346656037u;
+  size_t    i;
+
+  for (i = 0; i < size; ++i) {
+    hash = (hash ^ kp[i]) * 1099511628211u;
+  }
+  return hash;
+}
+
+static entry_t *
+Lookup(cache_t * const me, const uint64_t hash,
+       const unsigned char * const key, const size_t size)
+{
+  entry_t * ep;
+
+  for (ep = me->buckets[hash & (me->nbuckets - 1)]; ep; ep = ep->chain) {
+    if (ep->hash == hash && ep->size == size
+        && memcmp(ep->key, key, size) == 0) {
+      break;
+    }
+  }
+  return ep;
+}
+
+static void
+Front(cache_t * const me, entry_t * const ep)
+{
+  if (me->mru) {
+    ep->next = me->mru;
+    ep->prev = me->mru->prev;
+    ep->prev->next = ep->next->prev = ep;
+  } else {
+    ep->next = ep->prev = ep;
+  }
+  me->mru = ep;
+}
+
+static void
+Unlink(cache_t * const me, entry_t * const ep)
+{
+  if (ep->next == ep) {
+    me->mru = NULL;
+  } else {
+    ep->prev->next = ep->next;
+    ep->next->prev = ep->prev;
+    if (me->mru == ep) {
+      me->mru = ep->next;
+    }
+  }
+}
+
+static void
+Remove(cache_t * const me, entry_t * const ep)
+{
+  entry_t **  epp = &me->buckets[ep->hash & (me->nbuckets - 1)];
+
+  while (*epp != ep) {
+    epp = &(*epp)->chain;
+  }
+  *epp = ep->chain;
+  Unlink(me, ep);
+  --me->nentries;
+  me->size -= sizeof(entry_t) + ep->size;
+}
+
+void
+Cache_Add(cache_t * const me, const cam_context_t * const ctx,
+          const int result)
+{
+  const size_t  size = sizeof(entry_t) + ctx->key_size;
+  entry_t *     ep;
+  entry_t *     lru;
+  entry_t **    epp;
+
+  assert(me);
+  assert(ctx);
+
+  if (size > me->capacity - me->nbuckets * sizeof(entry_t *)
+      || !(ep = malloc(size))) {
+    return;
+  }
+  ep->hash = ctx->key_hash;
+  ep->size = ctx->key_size;
+  ep->result = result;
+  memcpy(ep->key, ctx->key, ctx->key_size);
+  pthread_mutex_lock(&me->lock);
+  if (Lookup(me, ep->hash, ep->key, ep->size)) {
+    pthread_mutex_unlock(&me->lock);
+    free(ep);
+    return;
+  }
+  while (me->size + size > me->capacity) {
+    lru = me->mru->prev;
+    Remove(me, lru);
+    free(lru);
+  }
+  epp = &me->buckets[ep->hash & (me->nbuckets - 1)];
+  ep->chain = *epp;
+  *epp = ep;
+  Front(me, ep);
+  ++me->nentries;
+  me->size += size;
+  pthread_mutex_unlock(&me->lock);
+}
+
+void
+Cache_Print(FILE * const out, cache_t * const me)
+{
+  size_t  lookups;
+
+  assert(out);
+  assert(me);
+
+  pthread_mutex_lock(&me->lock);
+  lookups = me->hits + me->misses;
+  fprintf(out, "cache: %zu hits, %zu misses, hit rate %.1f%%, "
+               "%zu entries, %zu bytes\n", me->hits, me->misses,
+          lookups ? 100.0 * (double)me->hits / (double)lookups : 0.0,
+          me->nentries, me->size);
+  pthread_mutex_unlock(&me->lock);
+}
+
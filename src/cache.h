@@ -0,0 +1,33 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "context.h"
+
+typedef struct cache_s {
+  pthread_mutex_t   lock;
+  struct entry_s ** buckets;
+  size_t            nbuckets;
+  struct entry_s *  mru;
+  size_t            nentries;
+  size_t            size;
+  size_t            capacity;
+  size_t            hits;
+  size_t            misses;
+} cache_t;
+
+extern bool Cache_Init(cache_t * const, const size_t);
+extern void Cache_Free(cache_t * const);
+extern bool Cache_Find(cache_t * const, cam_context_t * const,
+                       const tree_t * const, int * const);
+extern void Cache_Add(cache_t * const, const cam_context_t * const,
+                      const int);
+extern void Cache_Print(FILE * const, cache_t * const);
+
+#endif /* CACHE_H_ */
+
@@ -1,173 +1,369 @@
 #include "cam.h"
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 
-#include "pool.h"
-
-static statusCode_t VisitFst(cam_t * const, const ast_t *);
-static statusCode_t VisitSnd(cam_t * const, const ast_t *);
-static statusCode_t VisitQuote(cam_t * const, const ast_t *);
-static statusCode_t VisitApp(cam_t * const, const ast_t *);
-static statusCode_t VisitCur(cam_t * const, const ast_t *);
-static statusCode_t VisitPush(cam_t * const, const ast_t *);
-static statusCode_t VisitSwap(cam_t * const, const ast_t *);
-static statusCode_t VisitCons(cam_t * const, const ast_t *);
-static statusCode_t VisitPlus(cam_t * const, const ast_t *);
-
-void Cam_Init(cam_t * const me)
-{
-  static const visitVtbl_t vtbl = {
-                  VisitDefault,   /* VisitId */
-    (visitFunc_t) VisitApp,       /* VisitApp */
-    (visitFunc_t) VisitQuote,     /* VisitQuote */
-    (visitFunc_t) VisitPlus,      /* VisitPlus */
-    (visitFunc_t) VisitFst,       /* VisitFst */
-    (visitFunc_t) VisitSnd,       /* VisitSnd */
-                  VisitDefault,   /* PreVisitComp */
-    (visitFunc_t) VisitPush,      /* PreVisitPair */
-    (visitFunc_t) VisitCur,       /* PreVisitCur */
-    (visitFunc_t) VisitSwap,      /* InVisitPair */
-                  VisitDefault,   /* PostVisitComp */
-    (visitFunc_t) VisitCons,      /* PostVisitPair */
-                  VisitDefault    /* PostVisitCur */
-  };
+#include "except.h"
 
-  assert(me);
+enum {
+  N_FRAMES = 1024
+};
 
-  me->env = Env_Nil();
-  me->stack = NULL;
-  me->base.vptr = &vtbl;
+static void *
+Grow(cam_context_t * const ctx, void * const buff, size_t * const capacity,
+     const size_t size)
+{
+  void *  ptr;
+  size_t  cnt;
+
+  cnt = *capacity ? 2 * *capacity : N_FRAMES;
+  if (!(ptr = realloc(buff, cnt * size))) {
+    fprintf(stderr, "Out of memory.\n");
+    THROW(ctx->handler);
+  }
+  *capacity = cnt;
+  return ptr;
 }
 
-void Cam_Free(cam_t * const me)
+void Cam_Init(cam_t * const me, cam_context_t * const ctx)
 {
-  Env_Free(&me->env);
-  Env_FreeList(&me->stack);
+  assert(me);
+  assert(ctx);
+
+#if defined(ENV_GC)
+  Env_Reset(ctx);
+#endif
+  me->ctx = ctx;
+  me->env = Env_Nil(ctx);
+  me->stack = ctx->stack;
+  me->sp = 0;
 }
 
-static statusCode_t
-VisitQuote(cam_t * const me, const ast_t *ap)
+void Cam_Free(cam_t * const me)
 {
-  Env_Free(&me->env);
-  me->env = Env_Int(ap->value);
+  Env_Free(me->ctx, &me->env);
+  while (me->sp > 0) {
+    Env_Free(me->ctx, &me->stack[--me->sp]);
+  }
+}
 
-  return SC_CONTINUE;
+static inline void
+Reserve(cam_t * const me)
+{
+#if defined(ENV_GC)
+  if (Env_IsFull(me->ctx)) {
+    Env_Collect(me->ctx, &me->env, me->stack, me->sp);
+  }
+#else
+  (void)me;
+#endif
 }
 
-static statusCode_t
-VisitPush(cam_t * const me, const ast_t *ap)
+static inline void
+ExecQuote(cam_t * const me, const int value)
 {
-  (void)ap;
+  Env_Free(me->ctx, &me->env);
+  me->env = Env_Int(me->ctx, value);
+}
 
-  Push(&me->stack, Env_Copy(me->env));
+static inline void
+ExecPush(cam_t * const me)
+{
+  cam_context_t * const ctx = me->ctx;
 
-  return SC_CONTINUE;
+  if (me->sp == ctx->stack_capacity) {
+    me->stack = ctx->stack = Grow(ctx, ctx->stack, &ctx->stack_capacity,
+                                  sizeof(env_t *));
+  }
+  me->stack[me->sp++] = Env_Retain(me->env);
 }
 
-static statusCode_t
-VisitSwap(cam_t * const me, const ast_t *ap)
+static inline void
+ExecSwap(cam_t * const me)
 {
   env_t *  tmp;
 
-  (void)ap;
-  assert(me->stack != NULL);
+  assert(me->sp > 0);
 
-  tmp = Pop(&me->stack);
-  Push(&me->stack, me->env);
+  tmp = me->stack[me->sp - 1];
+  me->stack[me->sp - 1] = me->env;
   me->env = tmp;
-
-  return SC_CONTINUE;
 }
 
-static statusCode_t
-VisitCons(cam_t * const me, const ast_t *ap)
+static inline void
+ExecCons(cam_t * const me)
 {
-  (void)ap;
-  assert(me->stack != NULL);
+  assert(me->sp > 0);
 
-  me->env = Env_Pair((env_t *)Pop(&me->stack), me->env);
-
-  return SC_CONTINUE;
+  Reserve(me);
+  me->env = Env_Pair(me->ctx, me->stack[--me->sp], me->env);
 }
 
-static statusCode_t
-VisitFst(cam_t * const me, const ast_t *ap)
+static inline void
+ExecFst(cam_t * const me)
 {
   env_t *  proj;
 
-  (void)ap;
   assert(me->env->type == ENV_PAIR);
 
-  proj = Pop(&me->env->u.rchild);
-  proj->base.link = NULL; /* prevent dangling pointer */
-  Env_Free(&me->env);
+  proj = Env_Retain(me->env->u.pair.fst);
+  Env_Free(me->ctx, &me->env);
   me->env = proj;
-
-  return SC_CONTINUE;
 }
 
-static statusCode_t
-VisitSnd(cam_t * const me, const ast_t *ap)
+static inline void
+ExecSnd(cam_t * const me)
 {
   env_t *  proj;
 
-  (void)ap;
   assert(me->env->type == ENV_PAIR);
 
-  proj = me->env->u.rchild;
-  Env_Free((env_t **)&proj->base.link);
-  Pool_Free(&g_env_pool, (node_t *)me->env);
+  proj = Env_Retain(me->env->u.pair.snd);
+  Env_Free(me->ctx, &me->env);
   me->env = proj;
+}
 
-  return SC_CONTINUE;
+static inline void
+ExecAcc(cam_t * const me, int n)
+{
+  env_t *  it = me->env;
+  env_t *  proj;
+
+  for (; n > 0; --n) {
+    assert(it->type == ENV_PAIR);
+    it = it->u.pair.fst;
+  }
+  assert(it->type == ENV_PAIR);
+
+  proj = Env_Retain(it->u.pair.snd);
+  Env_Free(me->ctx, &me->env);
+  me->env = proj;
 }
 
-static statusCode_t
-VisitCur(cam_t * const me, const ast_t *ap)
+static inline const instr_t *
+ExecCur(cam_t * const me, const instr_t * const pc)
 {
-  me->env = Env_Closure(me->env, ap->rchild);
+  Reserve(me);
+  me->env = Env_Closure(me->ctx, me->env, pc + 1);
 
-  return SC_SKIP;
+  return pc + pc->arg;
 }
 
-static statusCode_t
-VisitApp(cam_t * const me, const ast_t *ap)
+static inline void
+ExecClos(cam_t * const me, const instr_t * const pc)
 {
-  env_t *   closure;
+  Reserve(me);
+  me->env = Env_Closure(me->ctx, me->env, pc + pc->arg);
+}
+
+static inline const instr_t *
+ExecApp(cam_t * const me)
+{
+  env_t *         closure;
+  env_t *         arg;
+  const instr_t * code;
 
-  (void)ap;
   assert(me->env->type == ENV_PAIR);
 
-  closure = Pop(&me->env->u.rchild);
+  Reserve(me);
+  closure = me->env->u.pair.fst;
+  arg = me->env->u.pair.snd;
   assert(closure->type == ENV_CLOSURE);
-
-  Push(&me->env->u.rchild, closure->u.cl.ctx);
-  Ast_Traverse(closure->u.cl.code, (visit_t *)me);
-  Pool_Free(&g_env_pool, (node_t *)closure);
-
-  return SC_CONTINUE;
+  code = closure->u.cl.code;
+
+  if (Env_IsUnique(me->env)) {
+    me->env->u.pair.fst = Env_Retain(closure->u.cl.ctx);
+    Env_Free(me->ctx, &closure);
+  } else {
+    closure = Env_Pair(me->ctx, Env_Retain(closure->u.cl.ctx),
+                       Env_Retain(arg));
+    Env_Free(me->ctx, &me->env);
+    me->env = closure;
+  }
+
+  return code;
 }
 
-static statusCode_t
-VisitPlus(cam_t * const me, const ast_t *ap)
+static inline void
+ExecPlus(cam_t * const me)
 {
   env_t *  left;
   env_t *  right;
-
-  (void)ap;
+  env_t *  sum;
 
   assert(me->env->type == ENV_PAIR);
-  left = Pop(&me->env->u.rchild);
-  assert(left->type == ENV_INT);
-  right = Pop(&me->env->u.rchild);
-  assert(right->type == ENV_INT);
-
-  left->u.num += right->u.num;
-  left->base.link = NULL; /* prevent dangling pointer */
-  Pool_Free(&g_env_pool, (node_t *)right);
-  Pool_Free(&g_env_pool, (node_t *)me->env);
-  me->env = left;
-
-  return SC_CONTINUE;
+  left = me->env->u.pair.fst;
+  assert(Env_IsInt(left));
+  right = me->env->u.pair.snd;
+  assert(Env_IsInt(right));
+
+  sum = Env_Int(me->ctx, (int)((unsigned int)Env_Num(left)
+                                + (unsigned int)Env_Num(right)));
+  Env_Free(me->ctx, &me->env);
+  me->env = sum;
+}
+
+static inline const instr_t *
+Count(cam_context_t * const ctx, const instr_t * const pc)
+{
+#if defined(CAM_STATS)
+  ++ctx->counters.instrs[pc->op];
+#else
+  (void)ctx;
+#endif
+  return pc;
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define CASE(op)     L_##op
+#define DISPATCH()   goto *Count(ctx, pc)->label
+#else
+#define CASE(op)     case op
+#define DISPATCH()   continue
+#endif
+
+void
+Cam_Run(cam_t * const me, code_t * const code)
+{
+  cam_context_t * const ctx = me->ctx;
+  const instr_t *       pc;
+  size_t                rsp = 0;
+
+  assert(me);
+  assert(code);
+
+  pc = code->start;
+#if defined(__GNUC__)
+  {
+    static const void * const labels[] = {
+      &&L_OP_FST, &&L_OP_SND, &&L_OP_ACC, &&L_OP_PUSH, &&L_OP_SWAP,
+      &&L_OP_CONS, &&L_OP_CUR, &&L_OP_CLOS, &&L_OP_APP, &&L_OP_TAPP,
+      &&L_OP_RET, &&L_OP_QUOTE, &&L_OP_PLUS, &&L_OP_HALT
+    };
+    size_t  i;
+
+    for (i = 0; i < code->len; ++i) {
+      code->start[i].label = labels[code->start[i].op];
+    }
+  }
+  DISPATCH();
+#else
+  for (;;) switch (Count(ctx, pc)->op) {
+#endif
+  CASE(OP_FST):
+    ExecFst(me);
+    ++pc;
+    DISPATCH();
+  CASE(OP_SND):
+    ExecSnd(me);
+    ++pc;
+    DISPATCH();
+  CASE(OP_ACC):
+    ExecAcc(me, pc->arg);
+    ++pc;
+    DISPATCH();
+  CASE(OP_PUSH):
+    ExecPush(me);
+    ++pc;
+    DISPATCH();
+  CASE(OP_SWAP):
+    ExecSwap(me);
+    ++pc;
+    DISPATCH();
+  CASE(OP_CONS):
+    ExecCons(me);
+    ++pc;
+    DISPATCH();
+  CASE(OP_QUOTE):
+    ExecQuote(me, pc->arg);
+    ++pc;
+    DISPATCH();
+  CASE(OP_PLUS):
+    ExecPlus(me);
+    ++pc;
+    DISPATCH();
+  CASE(OP_CUR):
+    pc = ExecCur(me, pc);
+    DISPATCH();
+  CASE(OP_CLOS):
+    ExecClos(me, pc);
+    ++pc;
+    DISPATCH();
+  CASE(OP_APP):
+    if (rsp == ctx->returns_capacity) {
+      ctx->returns = Grow(ctx, ctx->returns, &ctx->returns_capacity,
+                          sizeof(*ctx->returns));
+    }
+    ctx->returns[rsp++] = pc + 1;
+    pc = ExecApp(me);
+    DISPATCH();
+  CASE(OP_TAPP):
+    pc = ExecApp(me);
+    DISPATCH();
+  CASE(OP_RET):
+    assert(rsp > 0);
+    pc = ctx->returns[--rsp];
+    DISPATCH();
+  CASE(OP_HALT):
+    assert(rsp == 0);
+    return;
+#if !defined(__GNUC__)
+  }
+#endif
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+#undef CASE
+#undef DISPATCH
+
+const instr_t *
+Cam_Step(cam_t * const me, const instr_t * const pc)
+{
+  assert(me);
+  assert(pc);
+
+  switch (pc->op) {
+  case OP_FST:
+    ExecFst(me);
+    break;
+  case OP_SND:
+    ExecSnd(me);
+    break;
+  case OP_ACC:
+    ExecAcc(me, pc->arg);
+    break;
+  case OP_PUSH:
+    ExecPush(me);
+    break;
+  case OP_SWAP:
+    ExecSwap(me);
+    break;
+  case OP_CONS:
+    ExecCons(me);
+    break;
+  case OP_QUOTE:
+    ExecQuote(me, pc->arg);
+    break;
+  case OP_PLUS:
+    ExecPlus(me);
+    break;
+  case OP_CUR:
+    return ExecCur(me, pc);
+  case OP_CLOS:
+    ExecClos(me, pc);
+    break;
+  case OP_APP:
+  case OP_TAPP:
+    return ExecApp(me);
+  default:
+    assert(pc->op != OP_RET && pc->op != OP_HALT);
+    break;
+  }
+  return pc + 1;
 }
 
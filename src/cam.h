@@ -2,18 +2,23 @@
 #define CAM_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 
-#include "ast.h"
+#include "code.h"
+#include "context.h"
 #include "env.h"
 
 typedef struct {
-  visit_t   base;
-  env_t *   env;
-  env_t *   stack;
+  env_t *           env;
+  env_t **          stack;
+  size_t            sp;
+  cam_context_t *   ctx;
 } cam_t;
 
-extern void Cam_Init(cam_t * const);
+extern void Cam_Init(cam_t * const, cam_context_t * const);
 extern void Cam_Free(cam_t * const);
+extern void Cam_Run(cam_t * const, code_t * const);
+extern const instr_t *  Cam_Step(cam_t * const, const instr_t * const);
 
 #endif /* CAM_H_ */
 
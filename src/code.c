@@ -0,0 +1,274 @@
+#include "code.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "except.h"
+
+enum {
+  N_INSTRS = 1024,
+  N_BODIES = 256,
+  N_MARKS = 256
+};
+
+typedef struct mark_s {
+  uint32_t  pos;
+  uint32_t  node;
+} mark_t;
+
+typedef struct body_s {
+  size_t        start;
+  unsigned long hash;
+} body_t;
+
+static void Emit(code_t * const, const opcode_t, const int);
+static void Mark(code_t * const, size_t * const, const uint32_t,
+                 const uint32_t);
+static void Close(code_t * const);
+static void Share(code_t * const, const size_t);
+
+static void
+Emit(code_t * const me, const opcode_t op, const int arg)
+{
+  instr_t * ip;
+  size_t    cnt;
+
+  if (me->len == me->ctx->instrs_capacity) {
+    cnt = me->ctx->instrs_capacity ? 2 * me->ctx->instrs_capacity : N_INSTRS;
+    if (!(ip = realloc(me->ctx->instrs, cnt * sizeof(instr_t)))) {
+      fprintf(stderr, "Out of memory.\n");
+      THROW(me->ctx->handler);
+    }
+    me->start = me->ctx->instrs = ip;
+    me->ctx->instrs_capacity = cnt;
+  }
+  ip = &me->start[me->len++];
+  ip->label = NULL;
+  ip->op = op;
+  ip->arg = arg;
+}
+
+void
+Code_Compile(code_t * const me, cam_context_t * const ctx,
+             const tree_t * const tree)
+{
+  size_t    nmarks = 0;
+  uint32_t  i;
+  uint32_t  j;
+
+  assert(me);
+  assert(ctx);
+  assert(tree);
+
+  me->start = ctx->instrs;
+  me->len = 0;
+  me->open = 0;
+  me->ctx = ctx;
+  if (ctx->bodies) {
+    memset(ctx->bodies, 0, ctx->bodies_capacity * sizeof(body_t));
+  }
+  ctx->nbodies = 0;
+
+  for (i = 0; i < tree->len; ++i) {
+    while (nmarks > 0 && ctx->marks[nmarks - 1].pos == i) {
+      j = ctx->marks[--nmarks].node;
+      if (tree->types[j] == AST_CUR) {
+        Close(me);
+      } else if (i == j + tree->sizes[j]) {
+        Emit(me, OP_CONS, 0);
+      } else {
+        Emit(me, OP_SWAP, 0);
+      }
+    }
+    switch (tree->types[i]) {
+    case AST_FST:
+      Emit(me, OP_FST, 0);
+      break;
+    case AST_SND:
+      Emit(me, OP_SND, 0);
+      break;
+    case AST_ACC:
+      Emit(me, tree->values[i] > 0 ? OP_ACC : OP_SND, tree->values[i]);
+      break;
+    case AST_QUOTE:
+      Emit(me, OP_QUOTE, tree->values[i]);
+      break;
+    case AST_APP:
+      Emit(me, OP_APP, 0);
+      break;
+    case AST_PLUS:
+      Emit(me, OP_PLUS, 0);
+      break;
+    case AST_PAIR:
+      assert(tree->counts[i] == 2);
+      Emit(me, OP_PUSH, 0);
+      Mark(me, &nmarks, i + tree->sizes[i], i);
+      Mark(me, &nmarks, i + 1 + tree->sizes[i + 1], i);
+      break;
+    case AST_CUR:
+      Emit(me, OP_CUR, (int)me->open);
+      me->open = me->len;
+      Mark(me, &nmarks, i + tree->sizes[i], i);
+      break;
+    default:
+      break;
+    }
+  }
+  while (nmarks > 0 && ctx->marks[nmarks - 1].pos == i) {
+    j = ctx->marks[--nmarks].node;
+    if (tree->types[j] == AST_CUR) {
+      Close(me);
+    } else if (i == j + tree->sizes[j]) {
+      Emit(me, OP_CONS, 0);
+    } else {
+      Emit(me, OP_SWAP, 0);
+    }
+  }
+  Emit(me, OP_HALT, 0);
+  assert(me->open == 0);
+}
+
+static void
+Mark(code_t * const me, size_t * const nmarks, const uint32_t pos,
+     const uint32_t node)
+{
+  cam_context_t * const ctx = me->ctx;
+  mark_t *              mp;
+  size_t                cnt;
+
+  if (*nmarks == ctx->marks_capacity) {
+    cnt = ctx->marks_capacity ? 2 * ctx->marks_capacity : N_MARKS;
+    if (!(mp = realloc(ctx->marks, cnt * sizeof(mark_t)))) {
+      fprintf(stderr, "Out of memory.\n");
+      THROW(ctx->handler);
+    }
+    ctx->marks = mp;
+    ctx->marks_capacity = cnt;
+  }
+  ctx->marks[*nmarks].pos = pos;
+  ctx->marks[(*nmarks)++].node = node;
+}
+
+static void
+Close(code_t * const me)
+{
+  instr_t * ip;
+
+  assert(me->open > 0);
+
+  if (me->start[me->len - 1].op == OP_APP) {
+    me->start[me->len - 1].op = OP_TAPP;
+  } else {
+    Emit(me, OP_RET, 0);
+  }
+  ip = &me->start[me->open - 1];
+  assert(ip->op == OP_CUR);
+  me->open = (size_t)ip->arg;
+  ip->arg = (int)(&me->start[me->len] - ip);
+  Share(me, (size_t)(ip - me->start));
+}
+
+static inline opcode_t
+Op(const instr_t * const code, const size_t i)
+{
+  return code[i].op == OP_CUR ? OP_CLOS : code[i].op;
+}
+
+static inline int
+Arg(const instr_t * const code, const size_t i)
+{
+  switch (code[i].op) {
+  case OP_CUR:
+    return (int)i + 1;
+  case OP_CLOS:
+    return (int)i + code[i].arg;
+  default:
+    return code[i].arg;
+  }
+}
+
+static inline size_t
+Next(const instr_t * const code, const size_t i)
+{
+  return code[i].op == OP_CUR ? i + (size_t)code[i].arg : i + 1;
+}
+
+static unsigned long
+Hash(const instr_t * const code, const size_t start, const size_t end)
+{
+  unsigned long hash = 2166136261UL;
+  size_t        i;
+
+  for (i = start; i < end; i = Next(code, i)) {
+    hash = (hash ^ (unsigned long)Op(code, i)) * 16777619UL;
+    hash = (hash ^ (unsigned long)Arg(code, i)) * 16777619UL;
+  }
+  return hash;
+}
+
+static bool
+Equals(const instr_t * const code, const size_t lhs, const size_t rhs,
+       const size_t end)
+{
+  const size_t  last = lhs - 1 + (size_t)code[lhs - 1].arg;
+  size_t        i;
+  size_t        j;
+
+  for (i = lhs, j = rhs; i < last && j < end;
+       i = Next(code, i), j = Next(code, j)) {
+    if (Op(code, i) != Op(code, j) || Arg(code, i) != Arg(code, j)) {
+      return false;
+    }
+  }
+  return i == last && j == end;
+}
+
+static void
+Share(code_t * const me, const size_t pos)
+{
+  cam_context_t * const ctx = me->ctx;
+  const size_t        start = pos + 1;
+  const unsigned long hash = Hash(me->start, start, me->len);
+  size_t              i;
+
+  if (2 * (ctx->nbodies + 1) > ctx->bodies_capacity) {
+    body_t *  old = ctx->bodies;
+    size_t    cnt = ctx->bodies_capacity;
+    size_t    j;
+
+    ctx->bodies_capacity = cnt ? 2 * cnt : N_BODIES;
+    if (!(ctx->bodies = calloc(ctx->bodies_capacity, sizeof(body_t)))) {
+      ctx->bodies = old;
+      ctx->bodies_capacity = cnt;
+      fprintf(stderr, "Out of memory.\n");
+      THROW(ctx->handler);
+    }
+    for (j = 0; j < cnt; ++j) {
+      if (old[j].start) {
+        for (i = old[j].hash & (ctx->bodies_capacity - 1); ctx->bodies[i].start;
+             i = (i + 1) & (ctx->bodies_capacity - 1))
+          ;
+        ctx->bodies[i] = old[j];
+      }
+    }
+    free(old);
+  }
+  for (i = hash & (ctx->bodies_capacity - 1); ctx->bodies[i].start;
+       i = (i + 1) & (ctx->bodies_capacity - 1)) {
+    if (ctx->bodies[i].hash == hash
+        && Equals(me->start, ctx->bodies[i].start, start, me->len)) {
+      me->start[pos].op = OP_CLOS;
+      me->start[pos].arg = (int)ctx->bodies[i].start - (int)pos;
+      me->len = start;
+      return;
+    }
+  }
+  ctx->bodies[i].start = start;
+  ctx->bodies[i].hash = hash;
+  ++ctx->nbodies;
+}
+
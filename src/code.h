@@ -0,0 +1,27 @@
+#ifndef CODE_H_
+#define CODE_H_
+
+#include <stddef.h>
+
+#include "ast.h"
+#include "context.h"
+#include "opcode.h"
+
+typedef struct instr_s {
+  const void *  label;
+  opcode_t      op;
+  int           arg;
+} instr_t;
+
+typedef struct {
+  instr_t *         start;
+  size_t            len;
+  size_t            open;
+  cam_context_t *   ctx;
+} code_t;
+
+extern void Code_Compile(code_t * const, cam_context_t * const,
+                         const tree_t * const);
+
+#endif /* CODE_H_ */
+
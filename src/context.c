@@ -0,0 +1,106 @@
+#include "context.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "env.h"
+#include "jit.h"
+#include "parser.h"
+#include "pool.h"
+#include "trace.h"
+
+void
+Context_Init(cam_context_t * const me)
+{
+  const pool_t  ast_pool = INIT_POOL(ast_t, &me->handler);
+  const pool_t  env_pool = INIT_POOL(env_t, &me->handler);
+  const pool_t  symbol_pool = INIT_POOL(symbol_t, &me->handler);
+
+  assert(me);
+
+  me->handler = NULL;
+  me->ast_pool = ast_pool;
+  me->env_pool = env_pool;
+  me->symbol_pool = symbol_pool;
+  me->frames = NULL;
+  me->frames_capacity = me->depth = 0;
+  me->types = NULL;
+  me->values = NULL;
+  me->counts = me->sizes = NULL;
+  me->nodes_capacity = 0;
+  me->instrs = NULL;
+  me->instrs_capacity = 0;
+  me->bodies = NULL;
+  me->bodies_capacity = me->nbodies = 0;
+  me->marks = NULL;
+  me->marks_capacity = 0;
+  me->stack = NULL;
+  me->stack_capacity = 0;
+  me->returns = NULL;
+  me->returns_capacity = 0;
+  me->native = NULL;
+  me->native_capacity = 0;
+  me->slots = NULL;
+  me->slots_capacity = me->nids = 0;
+  me->generation = 0;
+  me->bindings = NULL;
+  me->bindings_capacity = 0;
+  me->rules = NULL;
+  me->rules_capacity = 0;
+  me->key = NULL;
+  me->key_capacity = me->key_size = 0;
+  me->key_hash = 0;
+  me->trace = NULL;
+  me->events = NULL;
+  me->nevents = me->spans = 0;
+  me->tid = 0;
+#if defined(ENV_GC)
+  me->nursery.start = me->nursery.top = me->nursery.limit = NULL;
+  me->old.start = me->old.top = me->old.limit = NULL;
+#endif
+#if defined(CAM_STATS)
+  memset(&me->counters, 0, sizeof(me->counters));
+#endif
+}
+
+void
+Context_Reset(cam_context_t * const me)
+{
+  assert(me);
+
+  Pool_Clear(&me->ast_pool);
+  Pool_Clear(&me->env_pool);
+  Pool_Clear(&me->symbol_pool);
+  me->depth = 0;
+  Trace_Unwind(me);
+}
+
+void
+Context_Free(cam_context_t * const me)
+{
+  Context_Reset(me);
+  free(me->frames);
+  free(me->types);
+  free(me->values);
+  free(me->counts);
+  free(me->sizes);
+  free(me->instrs);
+  free(me->bodies);
+  free(me->marks);
+  free(me->stack);
+  free(me->returns);
+  Jit_Free(me);
+  Trace_Detach(me);
+  free(me->slots);
+  free(me->bindings);
+  free(me->rules);
+  free(me->key);
+#if defined(ENV_GC)
+  free(me->nursery.start);
+  free(me->old.start);
+#endif
+  Context_Init(me);
+}
+
@@ -0,0 +1,85 @@
+#ifndef CONTEXT_H_
+#define CONTEXT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "except.h"
+#include "opcode.h"
+#include "pool.h"
+
+#if defined(ENV_GC)
+typedef struct {
+  struct env_s *  start;
+  struct env_s *  top;
+  struct env_s *  limit;
+} space_t;
+#endif
+
+#if defined(CAM_STATS)
+typedef struct {
+  size_t  instrs[N_OPCODES];
+  size_t  flattens;
+  size_t  collections;
+  size_t  copied;
+} counters_t;
+#endif
+
+typedef struct {
+  jmp_buf *               handler;
+  pool_t                  ast_pool;
+  pool_t                  env_pool;
+  pool_t                  symbol_pool;
+  struct frame_s *        frames;
+  size_t                  frames_capacity;
+  size_t                  depth;
+  unsigned char *         types;
+  int *                   values;
+  uint32_t *              counts;
+  uint32_t *              sizes;
+  size_t                  nodes_capacity;
+  struct instr_s *        instrs;
+  size_t                  instrs_capacity;
+  struct body_s *         bodies;
+  size_t                  bodies_capacity;
+  size_t                  nbodies;
+  struct mark_s *         marks;
+  size_t                  marks_capacity;
+  struct env_s **         stack;
+  size_t                  stack_capacity;
+  const struct instr_s ** returns;
+  size_t                  returns_capacity;
+  unsigned char *         native;
+  size_t                  native_capacity;
+  struct slot_s *         slots;
+  size_t                  slots_capacity;
+  size_t                  nids;
+  unsigned int            generation;
+  int *                   bindings;
+  size_t                  bindings_capacity;
+  struct rule_s *         rules;
+  size_t                  rules_capacity;
+  unsigned char *         key;
+  size_t                  key_capacity;
+  size_t                  key_size;
+  uint64_t                key_hash;
+  struct trace_s *        trace;
+  struct event_s *        events;
+  size_t                  nevents;
+  size_t                  spans;
+  unsigned int            tid;
+#if defined(ENV_GC)
+  space_t                 nursery;
+  space_t                 old;
+#endif
+#if defined(CAM_STATS)
+  counters_t              counters;
+#endif
+} cam_context_t;
+
+extern void Context_Init(cam_context_t * const);
+extern void Context_Free(cam_context_t * const);
+extern void Context_Reset(cam_context_t * const);
+
+#endif /* CONTEXT_H_ */
+
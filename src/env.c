@@ -1,129 +1,253 @@
 #include "env.h"
 
 #include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 
+#include "except.h"
 #include "pool.h"
 
-static env_t    g_pool[N_ELEMS];
-pool_t          g_env_pool = INIT_POOL(g_pool, N_ELEMS, env_t);
+#if defined(ENV_GC)
+enum {
+  N_NURSERY = 1 << 15
+};
+#endif
 
 env_t *
-Env_New(envType_t type)
+Env_New(cam_context_t * const ctx, envType_t type)
 {
-  env_t * me = Pool_Calloc(&g_env_pool);
+  env_t * me;
+
+#if defined(ENV_GC)
+  assert(ctx->nursery.top < ctx->nursery.limit);
+  me = ctx->nursery.top++;
+#else
+  me = Pool_Alloc(&ctx->env_pool);
+  me->refcnt = 1;
+#endif
   me->type = type;
   return me;
 }
 
 env_t *
-Env_Int(const int num)
-{
-  env_t * me = Pool_Calloc(&g_env_pool);
-  me->type = ENV_INT;
-  me->u.num = num;
-  return me;
-}
-
-env_t *
-Env_Pair(env_t * const left, env_t * const right)
+Env_Pair(cam_context_t * const ctx, env_t * const left, env_t * const right)
 {
   env_t *  me;
 
   assert(left);
   assert(right);
 
-  me = Pool_Calloc(&g_env_pool);
-  me->type = ENV_PAIR;
-  Push(&me->u.rchild, right);
-  Push(&me->u.rchild, left);
+  me = Env_New(ctx, ENV_PAIR);
+  me->u.pair.fst = left;
+  me->u.pair.snd = right;
   return me;
 }
 
 env_t *
-Env_Closure(env_t * const ctx, ast_t * const code)
+Env_Closure(cam_context_t * const ctx, env_t * const env,
+            const instr_t * const code)
 {
   env_t *  me;
 
-  assert(ctx);
+  assert(env);
   assert(code);
 
-  me = Pool_Calloc(&g_env_pool);
-  me->type = ENV_CLOSURE;
-  me->u.cl.ctx = ctx;
+  me = Env_New(ctx, ENV_CLOSURE);
+  me->u.cl.ctx = env;
   me->u.cl.code = code;
   return me;
 }
 
-env_t *
-Env_Copy(const env_t * const me)
+#if defined(ENV_GC)
+static void
+NewSpace(cam_context_t * const ctx, space_t * const me, const size_t cnt)
 {
-  env_t *  copy;
-
-  assert(me);
+  if (!(me->start = malloc(cnt * sizeof(env_t)))) {
+    fprintf(stderr, "Out of memory.\n");
+    THROW(ctx->handler);
+  }
+  me->top = me->start;
+  me->limit = me->start + cnt;
+}
 
-  copy = Env_New(me->type);
-  switch(me->type) {
-  case ENV_NIL:
-    break;
-  case ENV_INT:
-    copy->u.num = me->u.num;
-    break;
-  case ENV_CLOSURE:
-    copy->u.cl.ctx = Env_Copy(me->u.cl.ctx);
-    copy->u.cl.code = me->u.cl.code;
-    break;
-  case ENV_PAIR:
-    Push(&copy->u.rchild, Env_Copy(me->u.rchild));
-    Push(&copy->u.rchild, Env_Copy((env_t *)Link(me->u.rchild)));
-    break;
-  default:
-    assert(0);
+void
+Env_Reset(cam_context_t * const ctx)
+{
+  if (ctx->nursery.start == NULL) {
+    NewSpace(ctx, &ctx->nursery, N_NURSERY);
+  }
+  if (ctx->old.start == NULL) {
+    NewSpace(ctx, &ctx->old, N_NURSERY);
   }
-  return copy;
+  ctx->nursery.top = ctx->nursery.start;
+  ctx->old.top = ctx->old.start;
 }
 
-static node_t *
-Flatten(env_t * me)
+static inline bool
+Contains(const space_t * const me, const env_t * const ep)
 {
-  env_t * it;
+  return me->start <= ep && ep < me->limit;
+}
 
-  assert(me);
+static void
+Forward(env_t ** const ref, const space_t * const from, space_t * const to)
+{
+  env_t * ep = *ref;
 
-  it = Link(me);
-  do {
-    assert(it);
-    if (it->type == ENV_PAIR) {
-      Append(&me, it->u.rchild);
-    } else if (it->type == ENV_CLOSURE) {
-      Append(&me, it->u.cl.ctx);
+  if (Env_IsInt(ep) || !Contains(from, ep)) {
+    return;
+  }
+  if (ep->type != ENV_FORWARD) {
+    assert(to->top < to->limit);
+    *to->top = *ep;
+    ep->type = ENV_FORWARD;
+    ep->u.pair.fst = to->top++;
+  }
+  *ref = ep->u.pair.fst;
+}
+
+static void
+Scan(env_t * it, const space_t * const from, space_t * const to)
+{
+  for (; it < to->top; ++it) {
+    switch (it->type) {
+    case ENV_PAIR:
+      Forward(&it->u.pair.fst, from, to);
+      Forward(&it->u.pair.snd, from, to);
+      break;
+    case ENV_CLOSURE:
+      Forward(&it->u.cl.ctx, from, to);
+      break;
+    default:
+      break;
     }
-  } while ((it = Link(it)) != Link(me));
+  }
+}
 
-  return (node_t *)me;
+static void
+Evacuate(env_t ** const env, env_t ** const stack, const size_t sp,
+         const space_t * const from, space_t * const to)
+{
+  env_t *   scan = to->top;
+  size_t    i;
+
+  Forward(env, from, to);
+  for (i = 0; i < sp; ++i) {
+    Forward(&stack[i], from, to);
+  }
+  Scan(scan, from, to);
 }
 
 void
-Env_Free(env_t ** const me)
+Env_Collect(cam_context_t * const ctx, env_t ** const env,
+            env_t ** const stack, const size_t sp)
+{
+  space_t * const nursery = &ctx->nursery;
+  space_t * const old = &ctx->old;
+  space_t         prev;
+  space_t         next;
+  size_t          i;
+#if defined(CAM_STATS)
+  env_t *         top = old->top;
+#endif
+
+  assert(env);
+
+  if (old->limit - old->top >= nursery->top - nursery->start) {
+    Evacuate(env, stack, sp, nursery, old);
+  } else {
+    NewSpace(ctx, &next, 2 * (size_t)((old->top - old->start)
+                                      + (nursery->top - nursery->start)));
+    prev = *old;
+    *old = next;
+    Evacuate(env, stack, sp, nursery, old);
+    Forward(env, &prev, old);
+    for (i = 0; i < sp; ++i) {
+      Forward(&stack[i], &prev, old);
+    }
+    Scan(old->start, &prev, old);
+    free(prev.start);
+#if defined(CAM_STATS)
+    top = old->start;
+#endif
+  }
+  nursery->top = nursery->start;
+#if defined(CAM_STATS)
+  ++ctx->counters.collections;
+  ctx->counters.copied += (size_t)(old->top - top);
+#endif
+}
+
+#else
+env_t *
+Env_Retain(env_t * const me)
 {
   assert(me);
 
-  if (*me == NULL) {
-    return;
+  if (Env_IsInt(me)) {
+    return me;
+  }
+  assert(me->refcnt > 0);
+  ++me->refcnt;
+  return me;
+}
+
+static inline bool
+Dies(env_t * const me)
+{
+  if (Env_IsInt(me)) {
+    return false;
+  }
+  assert(me->refcnt > 0);
+  return --me->refcnt == 0;
+}
+
+static void
+Release(cam_context_t * const ctx, env_t * it)
+{
+  env_t *  held = NULL;
+  env_t *  next;
+
+  while (it) {
+    next = NULL;
+    if (it->type == ENV_PAIR) {
+      if (Dies(it->u.pair.fst)) {
+        next = it->u.pair.fst;
+      }
+      if (Dies(it->u.pair.snd)) {
+        if (next) {
+          it->u.pair.fst = held;
+          held = it;
+          it = next;
+          continue;
+        }
+        next = it->u.pair.snd;
+      }
+    } else if (it->type == ENV_CLOSURE && Dies(it->u.cl.ctx)) {
+      next = it->u.cl.ctx;
+    }
+    Pool_Free(&ctx->env_pool, it);
+    if (next == NULL && held != NULL) {
+      it = held;
+      held = it->u.pair.fst;
+      next = it->u.pair.snd;
+      Pool_Free(&ctx->env_pool, it);
+    }
+    it = next;
   }
-  (*me)->base.link = (node_t *)*me;
-  Pool_FreeList(&g_env_pool, Flatten(*me));
-  *me = NULL;
 }
 
 void
-Env_FreeList(env_t ** const me)
+Env_Free(cam_context_t * const ctx, env_t ** const me)
 {
   assert(me);
 
-  if (*me == NULL) {
-    return;
+  if (*me != NULL && Dies(*me)) {
+    Release(ctx, *me);
   }
-  Pool_FreeList(&g_env_pool, Flatten(*me));
   *me = NULL;
 }
 
+#endif
+
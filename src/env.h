@@ -1,41 +1,71 @@
 #ifndef ENV_H_
 #define ENV_H_
 
-#include "ast.h"
+#include <stdint.h>
 
-#define Env_Nil()  Env_New(ENV_NIL)
+#include "code.h"
+#include "context.h"
+#include "except.h"
+
+#define Env_Nil(cx)  Env_New((cx), ENV_NIL)
+
+#define Env_IsInt(me)   (((uintptr_t)(me) & 1) != 0)
+#define Env_Int(cx, n)  ((void)(cx), (env_t *)(((uintptr_t)(n) << 1) | 1))
+#define Env_Num(me)     ((int)((intptr_t)((uintptr_t)(me) - 1) / 2))
+
+typedef char immediates_fit_t[sizeof(uintptr_t) > sizeof(int) ? 1 : -1];
+
+#if !defined(ENV_GC)
+#define Env_IsUnique(me)    ((me)->refcnt == 1)
+#else
+#define Env_IsFull(cx)      ((cx)->nursery.top == (cx)->nursery.limit)
+#define Env_Retain(me)      (me)
+#define Env_Free(cx, me)    ((void)(cx), *(me) = NULL)
+#define Env_IsUnique(me)    ((void)(me), 0)
+#endif
 
 typedef struct env_s env_t;
 
 typedef enum {
   ENV_PAIR,
   ENV_NIL,      /* sentinel */
-  ENV_INT,      /* non-zero integers */
   ENV_CLOSURE,
+  ENV_FORWARD,  /* moved by the garbage collector */
 } envType_t;
 
 typedef struct {
-  env_t *       ctx;
-  ast_t *       code;
+  env_t *         ctx;
+  const instr_t * code;
 } closure_t;
 
+typedef struct {
+  env_t *       fst;
+  env_t *       snd;
+} pair_t;
+
 struct env_s {
-  node_t        base;
   union {
-    int         num;
-    env_t *     rchild;
+    pair_t      pair;
     closure_t   cl;
   }             u;
   envType_t     type;
+#if !defined(ENV_GC)
+  unsigned int  refcnt;
+#endif
 };
 
-extern env_t *    Env_New(envType_t);
-extern env_t *    Env_Int(const int);
-extern env_t *    Env_Pair(env_t * const, env_t * const);
-extern env_t *    Env_Closure(env_t * const, ast_t * const);
-extern env_t *    Env_Copy(const env_t * const);
-extern void       Env_Free(env_t ** const);
-extern void       Env_FreeList(env_t ** const);
+extern env_t *    Env_New(cam_context_t * const, envType_t);
+extern env_t *    Env_Pair(cam_context_t * const, env_t * const, env_t * const);
+extern env_t *    Env_Closure(cam_context_t * const, env_t * const,
+                              const instr_t * const);
+#if !defined(ENV_GC)
+extern env_t *    Env_Retain(env_t * const);
+extern void       Env_Free(cam_context_t * const, env_t ** const);
+#else
+extern void       Env_Collect(cam_context_t * const, env_t ** const,
+                              env_t ** const, const size_t);
+extern void       Env_Reset(cam_context_t * const);
+#endif
 
 #endif /* ENV_H_ */
 
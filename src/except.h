@@ -4,26 +4,26 @@
 #include <setjmp.h>
 #include <stdlib.h>
 
-#define TRY {                     \
-  jmp_buf handler;                \
+#define TRY(h) {                  \
+  jmp_buf     handler;            \
+  jmp_buf **  handlerp = &(h);    \
                                   \
-  g_handler = &handler;           \
+  *handlerp = &handler;           \
   if (!setjmp(handler)) {
 
 #define CATCH } else {
 
 #define END }                     \
-    g_handler = NULL;             \
+    *handlerp = NULL;             \
   }
 
-#define THROW do {                \
-  if (*g_handler) {               \
-      longjmp(*g_handler, 1);     \
+#define THROW(h) do {             \
+  if ((h)) {                      \
+    longjmp(*(h), 1);             \
   } else {                        \
     exit(1);                      \
   }                               \
 } while (0)
-extern jmp_buf *g_handler;
 
 #endif /* EXCEPT_H_ */
 
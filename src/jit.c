@@ -0,0 +1,499 @@
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__unix__)
+#define _DEFAULT_SOURCE
+#endif
+#include "jit.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "except.h"
+
+#if defined(JIT_X86_64)
+#include <sys/mman.h>
+#include <unistd.h>
+
+enum {
+  RAX = 0,
+  RCX = 1,
+  RDX = 2,
+  RBX = 3,
+  RSP = 4,
+  RSI = 6,
+  RDI = 7,
+  R12 = 12,
+  R14 = 14
+};
+
+enum {
+  MAX_OP_SZ = 160,
+  MAX_LOAD_SZ = 8,
+  N_NATIVE = 1 << 16
+};
+
+enum {
+  X86_STORE = 0x89,
+  X86_LOAD = 0x8B,
+  X86_LEA = 0x8D,
+  X86_CMP = 0x3B,
+  X86_CMP_IMM8 = 0x83,
+  X86_INC_DEC = 0xFF
+};
+
+enum {
+  JUMP = 0,
+  JNE = 0x85,
+  JNZ = 0x85,
+  JAE = 0x83
+};
+
+typedef struct {
+  unsigned char * pos;
+  cam_t *         cam;
+} jit_t;
+
+static void Translate(jit_t * const, const instr_t * const);
+static void Project(jit_t * const, int, const int32_t);
+static void Quote(jit_t * const, const int);
+static void Plus(jit_t * const);
+static void PushEnv(jit_t * const, const instr_t * const);
+static void SwapEnv(jit_t * const);
+static inline void
+Byte(jit_t * const me, const unsigned int byte)
+{
+  *me->pos++ = (unsigned char)byte;
+}
+
+static void
+Imm32(jit_t * const me, const int32_t value)
+{
+  uint32_t  bits = (uint32_t)value;
+  int       i;
+
+  for (i = 0; i < 4; ++i, bits >>= 8) {
+    Byte(me, bits & 0xFF);
+  }
+}
+
+static void
+Imm64(jit_t * const me, const void * const value)
+{
+  memcpy(me->pos, value, 8);
+  me->pos += 8;
+}
+
+static void
+Mem(jit_t * const me, const int wide, const unsigned int op, const int reg,
+    const int base, const int32_t disp)
+{
+  Byte(me, 0x40 | (wide ? 0x08 : 0) | ((reg & 8) >> 1) | (base >> 3));
+  Byte(me, op);
+  Byte(me, 0x80 | ((reg & 7) << 3) | (base & 7));
+  if ((base & 7) == RSP) {
+    Byte(me, 0x24);
+  }
+  Imm32(me, disp);
+}
+
+static void
+Move(jit_t * const me, const int dst, const int src)
+{
+  Byte(me, 0x48 | ((src & 8) >> 1) | (dst >> 3));
+  Byte(me, 0x89);
+  Byte(me, 0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+static void
+MoveImm(jit_t * const me, const int dst, const void * const value)
+{
+  Byte(me, 0x48 | (dst >> 3));
+  Byte(me, 0xB8 + (dst & 7));
+  Imm64(me, value);
+}
+
+static unsigned char *
+Jump(jit_t * const me, const unsigned int cond)
+{
+  if (cond) {
+    Byte(me, 0x0F);
+    Byte(me, cond);
+  } else {
+    Byte(me, 0xE9);
+  }
+  Imm32(me, 0);
+  return me->pos - 4;
+}
+
+static void
+Patch(unsigned char * const offset, const unsigned char * const target)
+{
+  const int32_t value = (int32_t)(target - (offset + 4));
+
+  memcpy(offset, &value, 4);
+}
+
+static inline void
+Land(jit_t * const me, unsigned char * const offset)
+{
+  Patch(offset, me->pos);
+}
+
+static void
+Call(jit_t * const me, const void * const fn)
+{
+  MoveImm(me, RAX, fn);
+  Byte(me, 0xFF);
+  Byte(me, 0xD0);
+}
+
+static inline void
+Store(jit_t * const me)
+{
+  Mem(me, 1, X86_STORE, R12, RBX, offsetof(cam_t, env));
+}
+
+static inline void
+Load(jit_t * const me)
+{
+  Mem(me, 1, X86_LOAD, R12, RBX, offsetof(cam_t, env));
+}
+
+static void
+Step(jit_t * const me, const instr_t * const pc)
+{
+  const instr_t * (* const step)(cam_t * const, const instr_t * const)
+      = Cam_Step;
+
+  Store(me);
+  Move(me, RDI, RBX);
+  MoveImm(me, RSI, &pc);
+  Call(me, &step);
+  Load(me);
+}
+
+#if !defined(ENV_GC)
+static void
+Retain(jit_t * const me, const int reg)
+{
+  unsigned char * imm;
+
+  Byte(me, 0x40 | (reg >> 3));
+  Byte(me, 0xF6);
+  Byte(me, 0xC0 | (reg & 7));
+  Byte(me, 0x01);
+  imm = Jump(me, JNZ);
+  Mem(me, 0, X86_INC_DEC, 0, reg, offsetof(env_t, refcnt));
+  Land(me, imm);
+}
+
+static void
+Release(jit_t * const me, const bool test)
+{
+  void (* const release)(cam_context_t * const, env_t ** const) = Env_Free;
+  const int       reg = R12;
+  unsigned char * imm = NULL;
+  unsigned char * shared;
+  unsigned char * done;
+
+  if (test) {
+    Byte(me, 0x40 | (reg >> 3));
+    Byte(me, 0xF6);
+    Byte(me, 0xC0 | (reg & 7));
+    Byte(me, 0x01);
+    imm = Jump(me, JNZ);
+  }
+  Mem(me, 0, X86_CMP_IMM8, 7, R12, offsetof(env_t, refcnt));
+  Byte(me, 1);
+  shared = Jump(me, JNE);
+  Store(me);
+  Mem(me, 1, X86_LOAD, RDI, RBX, offsetof(cam_t, ctx));
+  Mem(me, 1, X86_LEA, RSI, RBX, offsetof(cam_t, env));
+  Call(me, &release);
+  done = Jump(me, JUMP);
+  Land(me, shared);
+  Mem(me, 0, X86_INC_DEC, 1, R12, offsetof(env_t, refcnt));
+  Land(me, done);
+  if (imm) {
+    Land(me, imm);
+  }
+}
+#endif
+
+static unsigned char *
+Reserve(cam_context_t * const ctx, const code_t * const code)
+{
+  size_t  size = MAX_OP_SZ;
+  size_t  i;
+  void *  ptr;
+
+  for (i = 0; i < code->len; ++i) {
+    size += MAX_OP_SZ;
+    if (code->start[i].op == OP_ACC) {
+      size += MAX_LOAD_SZ * (size_t)code->start[i].arg;
+    }
+  }
+  if (size > ctx->native_capacity) {
+    Jit_Free(ctx);
+    size = (size + N_NATIVE - 1) / N_NATIVE * N_NATIVE;
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+      fprintf(stderr, "Out of memory.\n");
+      THROW(ctx->handler);
+    }
+    ctx->native = ptr;
+    ctx->native_capacity = size;
+  } else if (mprotect(ctx->native, ctx->native_capacity,
+                      PROT_READ | PROT_WRITE) != 0) {
+    fprintf(stderr, "Out of memory.\n");
+    THROW(ctx->handler);
+  }
+  return ctx->native;
+}
+
+void
+Jit_Free(cam_context_t * const ctx)
+{
+  if (ctx->native) {
+    munmap(ctx->native, ctx->native_capacity);
+  }
+  ctx->native = NULL;
+  ctx->native_capacity = 0;
+}
+
+void
+Jit_Run(cam_t * const me, code_t * const code)
+{
+  cam_context_t * const ctx = me->ctx;
+  jit_t                 jit;
+  void (*               run)(cam_t *);
+  size_t                i;
+
+  assert(me);
+  assert(code);
+
+  jit.pos = Reserve(ctx, code);
+  jit.cam = me;
+  Byte(&jit, 0x53);                             /* push rbx */
+  Byte(&jit, 0x41);                             /* push r12 */
+  Byte(&jit, 0x54);
+  Byte(&jit, 0x41);                             /* push r14 */
+  Byte(&jit, 0x56);
+  Move(&jit, RBX, RDI);
+  Load(&jit);
+  for (i = 0; i < code->len; ++i) {
+    code->start[i].label = jit.pos;
+    Translate(&jit, &code->start[i]);
+    assert(jit.pos - (unsigned char *)code->start[i].label <= MAX_OP_SZ
+           + MAX_LOAD_SZ * (code->start[i].op == OP_ACC ? code->start[i].arg
+                                                         : 0));
+  }
+  for (i = 0; i < code->len; ++i) {
+    if (code->start[i].op == OP_CUR) {
+      Patch((unsigned char *)code->start[i + 1].label - 4,
+            code->start[i + code->start[i].arg].label);
+    }
+  }
+  if (mprotect(ctx->native, ctx->native_capacity, PROT_READ | PROT_EXEC)) {
+    fprintf(stderr, "Out of memory.\n");
+    THROW(ctx->handler);
+  }
+  memcpy(&run, &ctx->native, sizeof(run));
+  run(me);
+}
+
+static void
+Translate(jit_t * const me, const instr_t * const pc)
+{
+  switch (pc->op) {
+  case OP_FST:
+    Project(me, 0, offsetof(env_t, u.pair.fst));
+    break;
+  case OP_SND:
+    Project(me, 0, offsetof(env_t, u.pair.snd));
+    break;
+  case OP_ACC:
+    Project(me, pc->arg, offsetof(env_t, u.pair.snd));
+    break;
+  case OP_QUOTE:
+    Quote(me, pc->arg);
+    break;
+  case OP_PLUS:
+    Plus(me);
+    break;
+  case OP_PUSH:
+    PushEnv(me, pc);
+    break;
+  case OP_SWAP:
+    SwapEnv(me);
+    break;
+  case OP_CUR:
+    Step(me, pc);
+    Jump(me, JUMP);
+    break;
+  case OP_APP:
+  case OP_TAPP:
+    Step(me, pc);
+    Mem(me, 1, X86_LOAD, RAX, RAX, offsetof(instr_t, label));
+    if (pc->op == OP_APP) {
+      Byte(me, 0x48);                             /* sub rsp, 8 */
+      Byte(me, 0x83);
+      Byte(me, 0xEC);
+      Byte(me, 0x08);
+      Byte(me, 0xFF);                             /* call rax */
+      Byte(me, 0xD0);
+      Byte(me, 0x48);                             /* add rsp, 8 */
+      Byte(me, 0x83);
+      Byte(me, 0xC4);
+      Byte(me, 0x08);
+    } else {
+      Byte(me, 0xFF);                             /* jmp rax */
+      Byte(me, 0xE0);
+    }
+    break;
+  case OP_RET:
+    Byte(me, 0xC3);                               /* ret */
+    break;
+  case OP_HALT:
+    Store(me);
+    Byte(me, 0x41);                               /* pop r14 */
+    Byte(me, 0x5E);
+    Byte(me, 0x41);                               /* pop r12 */
+    Byte(me, 0x5C);
+    Byte(me, 0x5B);                               /* pop rbx */
+    Byte(me, 0xC3);                               /* ret */
+    break;
+  default:
+    Step(me, pc);
+    break;
+  }
+}
+
+static void
+Project(jit_t * const me, int n, const int32_t offset)
+{
+#if defined(ENV_GC)
+  for (; n > 0; --n) {
+    Mem(me, 1, X86_LOAD, R12, R12, offsetof(env_t, u.pair.fst));
+  }
+  Mem(me, 1, X86_LOAD, R12, R12, offset);
+#else
+  Move(me, RAX, R12);
+  for (; n > 0; --n) {
+    Mem(me, 1, X86_LOAD, RAX, RAX, offsetof(env_t, u.pair.fst));
+  }
+  Mem(me, 1, X86_LOAD, R14, RAX, offset);
+  Retain(me, R14);
+  Release(me, false);
+  Move(me, R12, R14);
+#endif
+}
+
+static void
+Quote(jit_t * const me, const int value)
+{
+  env_t * const imm = Env_Int(me->cam->ctx, value);
+
+#if !defined(ENV_GC)
+  Release(me, true);
+#endif
+  MoveImm(me, R12, &imm);
+}
+
+static void
+Plus(jit_t * const me)
+{
+#if defined(ENV_GC)
+  const int sum = R12;
+#else
+  const int sum = R14;
+#endif
+
+  Mem(me, 1, X86_LOAD, RAX, R12, offsetof(env_t, u.pair.fst));
+  Mem(me, 1, X86_LOAD, RCX, R12, offsetof(env_t, u.pair.snd));
+  Byte(me, 0x48);                               /* sar rax, 1 */
+  Byte(me, 0xD1);
+  Byte(me, 0xF8);
+  Byte(me, 0x48);                               /* sar rcx, 1 */
+  Byte(me, 0xD1);
+  Byte(me, 0xF9);
+  Byte(me, 0x01);                               /* add eax, ecx */
+  Byte(me, 0xC8);
+  Byte(me, 0x48);                               /* movsxd rax, eax */
+  Byte(me, 0x63);
+  Byte(me, 0xC0);
+  Byte(me, 0x48 | ((sum & 8) >> 1));           /* lea sum, [rax+rax+1] */
+  Byte(me, 0x8D);
+  Byte(me, 0x44 | ((sum & 7) << 3));
+  Byte(me, 0x00);
+  Byte(me, 0x01);
+#if !defined(ENV_GC)
+  Release(me, false);
+  Move(me, R12, R14);
+#endif
+}
+
+static void
+PushEnv(jit_t * const me, const instr_t * const pc)
+{
+  unsigned char * full;
+  unsigned char * done;
+
+  Mem(me, 1, X86_LOAD, RAX, RBX, offsetof(cam_t, sp));
+  Mem(me, 1, X86_LOAD, RCX, RBX, offsetof(cam_t, ctx));
+  Mem(me, 1, X86_CMP, RAX, RCX, offsetof(cam_context_t, stack_capacity));
+  full = Jump(me, JAE);
+  Mem(me, 1, X86_LOAD, RCX, RBX, offsetof(cam_t, stack));
+  Byte(me, 0x4C);                               /* mov [rcx+rax*8], r12 */
+  Byte(me, 0x89);
+  Byte(me, 0x24);
+  Byte(me, 0xC1);
+  Byte(me, 0x48);                               /* inc rax */
+  Byte(me, 0xFF);
+  Byte(me, 0xC0);
+  Mem(me, 1, X86_STORE, RAX, RBX, offsetof(cam_t, sp));
+#if !defined(ENV_GC)
+  Retain(me, R12);
+#endif
+  done = Jump(me, JUMP);
+  Land(me, full);
+  Step(me, pc);
+  Land(me, done);
+}
+
+static void
+SwapEnv(jit_t * const me)
+{
+  Mem(me, 1, X86_LOAD, RAX, RBX, offsetof(cam_t, sp));
+  Mem(me, 1, X86_LOAD, RCX, RBX, offsetof(cam_t, stack));
+  Byte(me, 0x48);                               /* mov rdx, [rcx+rax*8-8] */
+  Byte(me, 0x8B);
+  Byte(me, 0x54);
+  Byte(me, 0xC1);
+  Byte(me, 0xF8);
+  Byte(me, 0x4C);                               /* mov [rcx+rax*8-8], r12 */
+  Byte(me, 0x89);
+  Byte(me, 0x64);
+  Byte(me, 0xC1);
+  Byte(me, 0xF8);
+  Move(me, R12, RDX);
+}
+
+#else
+void
+Jit_Run(cam_t * const me, code_t * const code)
+{
+  Cam_Run(me, code);
+}
+
+void
+Jit_Free(cam_context_t * const ctx)
+{
+  (void)ctx;
+}
+
+#endif
+
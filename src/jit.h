@@ -0,0 +1,16 @@
+#ifndef JIT_H_
+#define JIT_H_
+
+#include "cam.h"
+#include "code.h"
+#include "context.h"
+
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__unix__)
+#define JIT_X86_64
+#endif
+
+extern void Jit_Run(cam_t * const, code_t * const);
+extern void Jit_Free(cam_context_t * const);
+
+#endif /* JIT_H_ */
+
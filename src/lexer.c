@@ -1,70 +1,247 @@
 #include "lexer.h"
 
 #include <assert.h>
-#include <ctype.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "context.h"
+#include "except.h"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define LEXER_SSE2
+#endif
+
+enum {
+  CLASS_OTHER = 0,
+  CLASS_SPACE = 1,
+  CLASS_DIGIT = 2,
+  CLASS_ALPHA = 3,
+  CLASS_PUNCT = 4
+};
+
+#define _ CLASS_OTHER
+#define S CLASS_SPACE
+#define D CLASS_DIGIT
+#define A CLASS_ALPHA
+#define P CLASS_PUNCT
+static const unsigned char CLASSES[256] = {
+  _,_,_,_,_,_,_,_,_,S,S,S,S,S,_,_,  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_,
+  S,_,_,_,_,_,_,_,P,P,_,P,_,_,_,_,  D,D,D,D,D,D,D,D,D,D,_,_,_,_,_,_,
+  _,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,  A,A,A,A,A,A,A,A,A,A,A,_,_,_,_,_,
+  _,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,  A,A,A,A,A,A,A,A,A,A,A,_,_,_,_,_,
+  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_,  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_,
+  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_,  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_,
+  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_,  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_,
+  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_,  _,_,_,_,_,_,_,_,_,_,_,_,_,_,_,_
+};
+#undef _
+#undef S
+#undef D
+#undef A
+#undef P
+
+typedef struct slot_s {
+  const char *  name;
+  size_t        len;
+  size_t        hash;
+  unsigned int  generation;
+  int           id;
+} slot_t;
+
+static inline const char *  Skip(const char *, const char * const,
+                                 const int);
+static int                  Intern(cam_context_t * const,
+                                   const char * const, const size_t);
+static void                 Rehash(cam_context_t * const);
+
 void
-Lexer_Init(lexer_t * const me, const char * const input)
+Lexer_Init(lexer_t * const me, cam_context_t * const ctx,
+           const char * const input, const size_t len)
 {
   assert(me);
+  assert(ctx);
   assert(input);
 
-  me->token[0] = '\0';
+  me->token = input;
+  me->len = 0;
   me->type = LEX_NONE;
+  me->id = -1;
   me->ptr = input;
+  me->end = input + len;
+  me->ctx = ctx;
+  ctx->nids = 0;
+  if (++ctx->generation == 0) {
+    if (ctx->slots) {
+      memset(ctx->slots, 0, ctx->slots_capacity * sizeof(slot_t));
+    }
+    ctx->generation = 1;
+  }
 }
 
 int
 Lexer_NextToken(lexer_t * const me)
 {
-  char *  cp;
-
   assert(me);
 
-  for (; isspace(*me->ptr); ++me->ptr)
-    ;
-  cp = me->token;
-  switch (*me->ptr) {
-  case '\0':
+  me->ptr = Skip(me->ptr, me->end, CLASS_SPACE);
+  me->token = me->ptr;
+  if (me->ptr == me->end) {
+    me->len = 0;
     me->type = LEX_NONE;
+    return 0;
+  }
+  switch (CLASSES[(unsigned char)*me->ptr]) {
+  case CLASS_PUNCT:
+    me->type = *me->ptr++;
     break;
-  case '+': case '(': case ')':
-    me->type = *cp++ = *me->ptr++;
-    break;
-  case '0': case '1': case '2': case '3': case '4': case '5':
-  case '6': case '7': case '8': case '9':
-    do {
-      *cp++ = *me->ptr++;
-    } while (cp - me->token < MAXTOK && isdigit(*me->ptr));
+  case CLASS_DIGIT:
+    me->ptr = Skip(me->ptr + 1, me->end, CLASS_DIGIT);
     me->type = LEX_NUM;
     break;
-  case 'a': case 'b': case 'c': case 'd': case 'e': case 'f':
-  case 'g': case 'h': case 'i': case 'j': case 'k': case 'l':
-  case 'm': case 'n': case 'o': case 'p': case 'q': case 'r':
-  case 's': case 't': case 'u': case 'v': case 'w': case 'x':
-  case 'y': case 'z':
-  case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
-  case 'G': case 'H': case 'I': case 'J': case 'K': case 'L':
-  case 'M': case 'N': case 'O': case 'P': case 'Q': case 'R':
-  case 'S': case 'T': case 'U': case 'V': case 'W': case 'X':
-  case 'Y': case 'Z':
-    do {
-      *cp++ = *me->ptr++;
-    } while (cp - me->token < MAXTOK && isalpha(*me->ptr));
-    me->type = (strcmp(me->token, "lambda") == 0)
+  case CLASS_ALPHA:
+    me->ptr = Skip(me->ptr + 1, me->end, CLASS_ALPHA);
+    me->type = (me->ptr - me->token == 6
+                 && memcmp(me->token, "lambda", 6) == 0)
       ? LEX_LAMBDA
       : LEX_VAR;
+    if (me->type == LEX_VAR) {
+      me->id = Intern(me->ctx, me->token, (size_t)(me->ptr - me->token));
+    }
     break;
   default:
     fprintf(stderr, "Unexpected character: %c.\n", *me->ptr);
-    *cp = '\0';
+    me->len = 0;
     me->type = LEX_NONE;
     ++me->ptr;
     return -1;
   }
-  *cp = '\0';
-  return cp - me->token;
+  me->len = (size_t)(me->ptr - me->token);
+  return (int)me->len;
+}
+
+static inline const char *
+SkipScalar(const char *cp, const char * const end, const int cls)
+{
+  for (; cp != end && CLASSES[(unsigned char)*cp] == cls; ++cp)
+    ;
+  return cp;
+}
+
+#if defined(LEXER_SSE2)
+static inline __m128i
+InRange(const __m128i v, const char lo, const char hi)
+{
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+                       _mm_cmplt_epi8(v, _mm_set1_epi8((char)(hi + 1))));
+}
+
+static inline __m128i
+InClass(const __m128i v, const int cls)
+{
+  switch (cls) {
+  case CLASS_SPACE:
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                        InRange(v, '\t', '\r'));
+  case CLASS_DIGIT:
+    return InRange(v, '0', '9');
+  default:
+    return InRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+  }
+}
+#endif
+
+static inline const char *
+Skip(const char *cp, const char * const end, const int cls)
+{
+#if defined(LEXER_SSE2)
+  unsigned int  mask;
+
+  for (; end - cp >= 16; cp += 16) {
+    mask = (unsigned int)_mm_movemask_epi8(
+      InClass(_mm_loadu_si128((const __m128i *)cp), cls));
+    if (mask != 0xffff) {
+      return cp + __builtin_ctz(~mask);
+    }
+  }
+#endif
+  return SkipScalar(cp, end, cls);
+}
+
+static inline size_t
+Hash(const char *cp, const char * const end)
+{
+  size_t  hash = 2166136261U;
+
+  for (; cp != end; ++cp) {
+    hash = (hash ^ (unsigned char)*cp) * 16777619U;
+  }
+  return hash;
+}
+
+static int
+Intern(cam_context_t * const ctx, const char * const name, const size_t len)
+{
+  const size_t  hash = Hash(name, name + len);
+  slot_t *      sp;
+  size_t        i;
+
+  if (2 * (ctx->nids + 1) > ctx->slots_capacity) {
+    Rehash(ctx);
+  }
+  for (i = hash & (ctx->slots_capacity - 1);
+       (sp = &ctx->slots[i])->generation == ctx->generation;
+       i = (i + 1) & (ctx->slots_capacity - 1)) {
+    if (sp->hash == hash && sp->len == len
+        && memcmp(sp->name, name, len) == 0) {
+      return sp->id;
+    }
+  }
+  if (ctx->nids == ctx->bindings_capacity) {
+    int *         bindings;
+    const size_t  capacity = ctx->nids ? 2 * ctx->nids : 64;
+
+    if (!(bindings = realloc(ctx->bindings, capacity * sizeof(int)))) {
+      fprintf(stderr, "Out of memory.\n");
+      THROW(ctx->handler);
+    }
+    ctx->bindings = bindings;
+    ctx->bindings_capacity = capacity;
+  }
+  sp->name = name;
+  sp->len = len;
+  sp->hash = hash;
+  sp->generation = ctx->generation;
+  sp->id = (int)ctx->nids++;
+  ctx->bindings[sp->id] = -1;
+  return sp->id;
+}
+
+static void
+Rehash(cam_context_t * const ctx)
+{
+  const size_t  capacity = ctx->slots_capacity ? 2 * ctx->slots_capacity : 64;
+  slot_t *      slots;
+  size_t        i;
+  size_t        j;
+
+  if (!(slots = calloc(capacity, sizeof(slot_t)))) {
+    fprintf(stderr, "Out of memory.\n");
+    THROW(ctx->handler);
+  }
+  for (i = 0; i < ctx->slots_capacity; ++i) {
+    if (ctx->slots[i].generation == ctx->generation) {
+      for (j = ctx->slots[i].hash & (capacity - 1);
+           slots[j].generation == ctx->generation;
+           j = (j + 1) & (capacity - 1))
+        ;
+      slots[j] = ctx->slots[i];
+    }
+  }
+  free(ctx->slots);
+  ctx->slots = slots;
+  ctx->slots_capacity = capacity;
 }
 
@@ -1,9 +1,9 @@
 #ifndef LEXER_H_
 #define LEXER_H_
 
-enum {
-  MAXTOK = 10
-};
+#include <stddef.h>
+
+#include "context.h"
 
 typedef enum {
   /* multi-character tokens */
@@ -21,12 +21,17 @@ typedef enum {
 } tokenType_t;
 
 typedef struct lexer_s {
-  char          token[MAXTOK + 1];
-  tokenType_t   type;
-  const char *  ptr;
+  const char *    token;
+  size_t          len;
+  tokenType_t     type;
+  int             id;
+  const char *    ptr;
+  const char *    end;
+  cam_context_t * ctx;
 } lexer_t;
 
-extern void   Lexer_Init(lexer_t * const, const char * const);
+extern void   Lexer_Init(lexer_t * const, cam_context_t * const,
+                         const char * const, const size_t);
 extern int    Lexer_NextToken(lexer_t * const);
 
 #endif /* LEXER_H_ */
@@ -1,78 +1,297 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "aot.h"
 #include "ast.h"
+#include "batch.h"
+#include "cache.h"
 #include "cam.h"
+#include "code.h"
+#include "context.h"
 #include "env.h"
 #include "except.h"
+#include "jit.h"
 #include "lexer.h"
 #include "optim.h"
 #include "parser.h"
 #include "pool.h"
+#include "stats.h"
+#include "stream.h"
+#include "trace.h"
 
-enum {
-  BUFF_SZ = 256
-};
+static bool     g_jit = false;
 
-jmp_buf *   g_handler;
+static trace_t  g_trace;
+static bool     g_tracing = false;
 
-static int
-Evaluate(const char * const buff)
+static cache_t  g_cache;
+static bool     g_caching = false;
+
+#if defined(CAM_STATS)
+#define STATS_AVAILABLE true
+#define STATS_USAGE     " [--stats]"
+#else
+#define STATS_AVAILABLE false
+#define STATS_USAGE     ""
+#endif
+
+static bool TryEvaluate(cam_context_t * const, const char * const,
+                        const size_t, int * const);
+static void TryTranslate(cam_context_t * const, const char * const,
+                         const size_t, aot_t * const);
+
+static ast_t *
+Read(cam_context_t * const ctx, const char * const buff, const size_t len)
 {
   ast_t * ap;
-  cam_t   cam;
   lexer_t lexer;
+
+  Trace_Begin(ctx, "parse");
+  Lexer_Init(&lexer, ctx, buff, len);
+  ap = Parse(ctx, &lexer);
+  Trace_End(ctx);
+
+  return ap;
+}
+
+static void
+Compile(cam_context_t * const ctx, ast_t * ap, code_t * const code)
+{
   optim_t optim;
-  int     result = -1;
+  tree_t  tree;
+
+  Trace_Begin(ctx, "optimize");
+  Optim_Init(&optim, ctx);
+  Ast_Traverse(ctx, ap, (visit_t *)&optim);
+  Trace_End(ctx);
 
-  Lexer_Init(&lexer, buff);
-  ap = Parse(&lexer);
+  Trace_Begin(ctx, "compile");
+  Ast_Pack(ctx, ap, &tree);
+  Ast_Free(ctx, &ap);
+  Code_Compile(code, ctx, &tree);
+  Trace_End(ctx);
+}
 
-  do {
-    Optim_Init(&optim);
-    Ast_Traverse(ap, (visit_t *)&optim);
-    Ast_Free(&ap);
-    ap = Pop(&optim.stack);
-    assert(IsEmpty(optim.stack));
-  } while (optim.cnt != 0);
+static int
+Evaluate(cam_context_t * const ctx, const char * const buff, const size_t len)
+{
+  ast_t * ap;
+  cam_t   cam;
+  code_t  code;
+  tree_t  tree;
+  bool    hit;
+  int     result = -1;
 
-  Cam_Init(&cam);
-  Ast_Traverse(ap, (visit_t *)&cam);
-  assert(cam.env->type == ENV_INT);
-  result = cam.env->u.num;
+  ap = Read(ctx, buff, len);
+  if (g_caching) {
+    Trace_Begin(ctx, "lookup");
+    Ast_Pack(ctx, ap, &tree);
+    hit = Cache_Find(&g_cache, ctx, &tree, &result);
+    Trace_End(ctx);
+    if (hit) {
+      Ast_Free(ctx, &ap);
+      return result;
+    }
+  }
+  Compile(ctx, ap, &code);
+  Trace_Begin(ctx, "run");
+  Cam_Init(&cam, ctx);
+  if (g_jit) {
+    Jit_Run(&cam, &code);
+  } else {
+    Cam_Run(&cam, &code);
+  }
+  Trace_End(ctx);
+  assert(Env_IsInt(cam.env));
+  result = Env_Num(cam.env);
 
+  if (g_caching) {
+    Cache_Add(&g_cache, ctx, result);
+  }
   Cam_Free(&cam);
-  Ast_Free(&ap);
   return result;
 }
 
 int
-main()
+main(int argc, char *argv[])
 {
-  char    buff[BUFF_SZ];
-  char *  cp;
-
-  for (;;) {
-    for (cp=buff; cp-buff<BUFF_SZ && (*cp=getchar())!='\n'; ++cp)
-      ;
-    if (cp - buff == BUFF_SZ) {
-      fprintf(stderr, "Input too long.\n");
-      continue;
+  static writer_t out;
+  aot_t           aot;
+  cam_context_t   ctx;
+  reader_t        in;
+  const char *    term;
+  const char *    path = NULL;
+  char *          cp;
+  size_t          len;
+  long            jobs = 0;
+  long            kbytes = 0;
+  bool            emit = false;
+  bool            stats = false;
+  int             i;
+  int             status = 0;
+#if defined(CAM_STATS)
+  stats_t         before;
+  stats_t         after;
+  size_t          nterms = 0;
+#endif
+
+  for (i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      jobs = strtol(argv[++i], &cp, 10);
+      if (*cp != '\0' || jobs < 1) {
+        goto usage;
+      }
+    } else if (strcmp(argv[i], "--jit") == 0) {
+      g_jit = true;
+    } else if (strcmp(argv[i], "--emit-c") == 0) {
+      emit = true;
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      kbytes = strtol(argv[++i], &cp, 10);
+      if (*cp != '\0' || kbytes < 1) {
+        goto usage;
+      }
+    } else if (STATS_AVAILABLE && strcmp(argv[i], "--stats") == 0) {
+      stats = true;
+    } else {
+      goto usage;
+    }
+  }
+  if (emit && (jobs > 0 || kbytes > 0)) {
+    goto usage;
+  }
+  if (stats && jobs > 0) {
+    goto usage;
+  }
+  Writer_Init(&out, stdout);
+  if (!Reader_Init(&in, stdin, &out)) {
+    return 1;
+  }
+  if (kbytes > 0) {
+    if (!Cache_Init(&g_cache, (size_t)kbytes * 1024)) {
+      fprintf(stderr, "Out of memory.\n");
+      Reader_Free(&in);
+      return 1;
+    }
+    g_caching = true;
+  }
+
+  if (path) {
+    if (!Trace_Open(&g_trace, path)) {
+      fprintf(stderr, "Unable to open %s.\n", path);
+      if (g_caching) {
+        Cache_Free(&g_cache);
+      }
+      Reader_Free(&in);
+      return 1;
+    }
+    g_tracing = true;
+  }
+
+  if (jobs > 0) {
+    status = Batch_Run((size_t)jobs, TryEvaluate, &in, &out);
+  } else {
+    Context_Init(&ctx);
+    if (emit) {
+      Aot_Init(&aot, stdout);
     }
-    *cp = '\0';
+    while ((term = Reader_Next(&in, &len))) {
+      if (len == 4 && memcmp("halt", term, 4) == 0) {
+        break;
+      }
 
-    if (strcmp("halt", buff) == 0) {
-      return 0;
+#if defined(CAM_STATS)
+      if (stats) {
+        Stats_Reset(&ctx);
+        Stats_Get(&ctx, &before);
+      }
+#endif
+      if (emit) {
+        TryTranslate(&ctx, term, len, &aot);
+      } else if (TryEvaluate(&ctx, term, len, &i)) {
+        Writer_Int(&out, i);
+        Writer_Char(&out, '\n');
+      }
+#if defined(CAM_STATS)
+      if (stats) {
+        Stats_Get(&ctx, &after);
+        fprintf(stderr, "term %zu:\n", ++nterms);
+        Stats_Print(stderr, &after, &before);
+      }
+#endif
+    }
+    if (emit && !Aot_Finish(&aot)) {
+      status = 1;
+    }
+#if defined(CAM_STATS)
+    if (stats) {
+      Stats_Get(&ctx, &after);
+      fprintf(stderr, "total:\n");
+      Stats_Print(stderr, &after, NULL);
     }
+#endif
+    Context_Free(&ctx);
+  }
+  if (g_caching) {
+    Cache_Print(stderr, &g_cache);
+    Cache_Free(&g_cache);
+  }
+  if (g_tracing && !Trace_Close(&g_trace)) {
+    fprintf(stderr, "Unable to write %s.\n", path);
+    status = 1;
+  }
+  if (!Writer_Flush(&out)) {
+    fprintf(stderr, "Unable to write output.\n");
+    status = 1;
+  }
+  Reader_Free(&in);
+  return status;
+usage:
+  fprintf(stderr, "Usage: %s [--jobs N] [--jit] [--emit-c] [--trace FILE] "
+                  "[--cache K]%s\n", argv[0], STATS_USAGE);
+  return 1;
+}
+
+static bool
+TryEvaluate(cam_context_t * const ctx, const char * const buff,
+            const size_t len, int * const result)
+{
+  bool  ok = false;
+
+  if (g_tracing) {
+    Trace_Attach(ctx, &g_trace);
+  }
+  TRY(ctx->handler)
+    Trace_Begin(ctx, "term");
+    *result = Evaluate(ctx, buff, len);
+    Trace_End(ctx);
+    ok = true;
+  CATCH
+    Context_Reset(ctx);
+  END
+  return ok;
+}
+
+static void
+TryTranslate(cam_context_t * const ctx, const char * const buff,
+             const size_t len, aot_t * const aot)
+{
+  code_t  code;
 
-    TRY
-      printf("%d\n", Evaluate(buff));
-    CATCH
-      Pool_Clear(&g_ast_pool);
-      Pool_Clear(&g_env_pool);
-      Pool_Clear(&g_symbol_pool);
-    END
+  if (g_tracing) {
+    Trace_Attach(ctx, &g_trace);
   }
+  TRY(ctx->handler)
+    Trace_Begin(ctx, "term");
+    Compile(ctx, Read(ctx, buff, len), &code);
+    Aot_Term(aot, &code);
+    Trace_End(ctx);
+  CATCH
+    Context_Reset(ctx);
+  END
 }
 
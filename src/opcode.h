@@ -0,0 +1,23 @@
+#ifndef OPCODE_H_
+#define OPCODE_H_
+
+typedef enum {
+  OP_FST,
+  OP_SND,
+  OP_ACC,
+  OP_PUSH,
+  OP_SWAP,
+  OP_CONS,
+  OP_CUR,
+  OP_CLOS,
+  OP_APP,
+  OP_TAPP,
+  OP_RET,
+  OP_QUOTE,
+  OP_PLUS,
+  OP_HALT,
+  N_OPCODES
+} opcode_t;
+
+#endif /* OPCODE_H_ */
+
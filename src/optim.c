@@ -6,158 +6,244 @@
 
 #include "pool.h"
 
-static statusCode_t PreVisitParent(optim_t * const, const ast_t *);
-static statusCode_t PostVisitParent(optim_t * const, const ast_t *);
-static statusCode_t VisitLeaf(optim_t * const, const ast_t *);
-static statusCode_t VisitFst(optim_t * const, const ast_t *);
-static statusCode_t VisitSnd(optim_t * const, const ast_t *);
-static statusCode_t VisitApp(optim_t * const, const ast_t *);
+static statusCode_t PostVisitComp(optim_t * const, const ast_t *);
+static void         Unwrap(cam_context_t * const, ast_t * const);
+
+static ast_t *      Top(ast_t * const);
+static bool         Reduces(const ast_t * const, const ast_t * const);
+static ast_t *      Detach(cam_context_t * const, ast_t ** const);
 
 void
-Optim_Init(optim_t * const me)
+Optim_Init(optim_t * const me, cam_context_t * const ctx)
 {
   static const visitVtbl_t vtbl = {
-    (visitFunc_t) VisitLeaf,        /* VisitId */
-    (visitFunc_t) VisitApp,         /* VisitApp */
-    (visitFunc_t) VisitLeaf,        /* VisitQuote */
-    (visitFunc_t) VisitLeaf,        /* VisitPlus */
-    (visitFunc_t) VisitFst,         /* VisitFst */
-    (visitFunc_t) VisitSnd,         /* VisitSnd */
-    (visitFunc_t) PreVisitParent,   /* PreVisitComp */
-    (visitFunc_t) PreVisitParent,   /* PreVisitPair */
-    (visitFunc_t) PreVisitParent,   /* PreVisitCur */
+                  VisitDefault,     /* VisitId */
+                  VisitDefault,     /* VisitApp */
+                  VisitDefault,     /* VisitQuote */
+                  VisitDefault,     /* VisitPlus */
+                  VisitDefault,     /* VisitFst */
+                  VisitDefault,     /* VisitSnd */
+                  VisitDefault,     /* VisitAcc */
+                  VisitDefault,     /* PreVisitComp */
+                  VisitDefault,     /* PreVisitPair */
+                  VisitDefault,     /* PreVisitCur */
                   VisitDefault,     /* InVisitPair */
-    (visitFunc_t) PostVisitParent,  /* PostVisitComp */
-    (visitFunc_t) PostVisitParent,  /* PostVisitPair */
-    (visitFunc_t) PostVisitParent   /* PostVisitCur */
+    (visitFunc_t) PostVisitComp,    /* PostVisitComp */
+                  VisitDefault,     /* PostVisitPair */
+                  VisitDefault      /* PostVisitCur */
   };
 
   assert(me);
+  assert(ctx);
 
-  me->stack = NULL;
   me->cnt = 0;
+  me->ctx = ctx;
   me->base.vptr = &vtbl;
 }
 
-static inline bool
-IsSibling(const ast_t * const ap)
-{
-  return ap->rchild != ap;
-}
-
 static statusCode_t
-PreVisitParent(optim_t * const me, const ast_t *ap)
+PostVisitComp(optim_t * const me, const ast_t *ap)
 {
-  ast_t * copy;
-
-  (void)ap;
-  copy = Ast_Node(ap->type);
-  copy->rchild = copy;
-  Push(&me->stack, copy);
-  return SC_CONTINUE;
-}
-
-static statusCode_t
-PostVisitParent(optim_t * const me, const ast_t *ap)
-{
-  ast_t *   head;
-  ast_t *   children = NULL;
-
-  for (;;) {
-    head = Pop(&me->stack);
-    assert(head);
-    if (!IsSibling(head)) {
-      /* head must be a parent */
+  ast_t * const parent = (ast_t *)ap;
+  ast_t *       todo = parent->rchild;
+  ast_t *       done = NULL;
+  ast_t *       head;
+  ast_t *       top;
+  ast_t *       cur;
+  ast_t *       prev;
+  ast_t *       lambda;
+
+  while ((head = Pop(&todo))) {
+    top = Top(done);
+    switch (head->type) {
+    case AST_COMP:
+      if (Reduces(top, Peek(head->rchild))) {
+        cur = Pop(&head->rchild);
+        if (head->rchild) {
+          Push(&todo, head);
+        } else {
+          Pool_Free(&me->ctx->ast_pool, (node_t *)head);
+        }
+        Push(&todo, cur);
+      } else {
+        Push(&done, head);
+      }
+      ++me->cnt;
+      continue;
+    case AST_ID:
+      Pool_Free(&me->ctx->ast_pool, (node_t *)head);
+      ++me->cnt;
+      continue;
+    default:
       break;
     }
-    if (ap->type == AST_COMP) {
-      switch (head->type) {
-      case AST_COMP:
-        Prepend(&children, head->rchild);
-        /* Fall-through */
-      case AST_ID:
-        Pool_Free(&g_ast_pool, (node_t *)head);
-        ++me->cnt;
-        continue;
-      default:
-        break;
+    if (!Reduces(top, head)) {
+      Push(&done, head);
+      continue;
+    }
+    switch (head->type) {
+    case AST_FST:
+    case AST_SND:
+      top = Detach(me->ctx, &done);
+      if (head->type == AST_FST) {
+        Push(&todo, Pop(&top->rchild));
+        Ast_Free(me->ctx, &top);
+      } else {
+        Ast_Free(me->ctx, (ast_t **)&top->rchild->base.link);
+        Push(&todo, top->rchild);
+        Pool_Free(&me->ctx->ast_pool, (node_t *)top);
+      }
+      Pool_Free(&me->ctx->ast_pool, (node_t *)head);
+      break;
+    case AST_ACC:
+      top = Detach(me->ctx, &done);
+      if (head->value == 0) {
+        Ast_Free(me->ctx, (ast_t **)&top->rchild->base.link);
+        Push(&todo, top->rchild);
+        Pool_Free(&me->ctx->ast_pool, (node_t *)top);
+        Pool_Free(&me->ctx->ast_pool, (node_t *)head);
+      } else {
+        --head->value;
+        Push(&todo, head);
+        Push(&todo, Pop(&top->rchild));
+        Ast_Free(me->ctx, &top);
       }
+      break;
+    case AST_APP:
+      cur = Peek(top->rchild);
+      if (cur->type == AST_CUR) {
+        Pop(&top->rchild);
+        head->type = AST_ID;
+        Ast_AddChild(top, head);
+      } else {
+        prev = cur->rchild;
+        while (Link(prev) != cur->rchild) {
+          prev = Link(prev);
+        }
+        lambda = cur->rchild;
+        prev->base.link = lambda->base.link;
+        cur->rchild = prev;
+        if (prev == Link(prev)) {
+          Unwrap(me->ctx, cur);
+        }
+        cur = lambda;
+        Pool_Free(&me->ctx->ast_pool, (node_t *)head);
+      }
+      Push(&todo, cur->rchild);
+      Pool_Free(&me->ctx->ast_pool, (node_t *)cur);
+      break;
+    case AST_PLUS:
+      top = Detach(me->ctx, &done);
+      head->type = AST_QUOTE;
+      head->value = (int)((unsigned int)((ast_t *)Link(top->rchild))->value
+                          + (unsigned int)top->rchild->value);
+      Ast_Free(me->ctx, &top);
+      Push(&todo, head);
+      break;
+    case AST_QUOTE:
+      while ((top = Pop(&done))) {
+        Ast_Free(me->ctx, &top);
+      }
+      Push(&done, head);
+      break;
+    default:
+      assert(false);
     }
-    Push(&children, head);
+    ++me->cnt;
   }
 
-  Ast_SetChildren(head, children);
-
-  if (head->type == AST_COMP && head->rchild == NULL) {
-    head->type = AST_ID;
+  parent->rchild = NULL;
+  while ((head = Pop(&done))) {
+    if (head->type == AST_COMP) {
+      Prepend(&parent->rchild, head->rchild);
+      Pool_Free(&me->ctx->ast_pool, (node_t *)head);
+    } else {
+      Push(&parent->rchild, head);
+    }
+  }
+  if (parent->rchild == NULL) {
+    parent->type = AST_ID;
+  } else if (parent->rchild == Link(parent->rchild)) {
+    Unwrap(me->ctx, parent);
+    ++me->cnt;
   }
-
-  Push(&me->stack, head);
 
   return SC_CONTINUE;
 }
 
-static statusCode_t
-VisitLeaf(optim_t * const me, const ast_t *ap)
+static ast_t *
+Top(ast_t * const done)
 {
-  ast_t * copy;
-
-  copy = Ast_Node(ap->type);
-  copy->value = ap->value;
-  Push(&me->stack, copy);
+  ast_t * const top = Peek(done);
 
-  return SC_CONTINUE;
+  return top && top->type == AST_COMP ? top->rchild : top;
 }
 
-static statusCode_t
-VisitFst(optim_t * const me, const ast_t *ap)
+static bool
+Reduces(const ast_t * const top, const ast_t * const ap)
 {
-  ast_t * head;
+  const ast_t * cur;
 
-  if ((head = Peek(me->stack)) && IsSibling(head)
-        && head->type == AST_PAIR) {
-    Pop(&me->stack);
-    Push(&me->stack, Pop(&head->rchild));
-    Ast_Free(&head);
-    ++me->cnt;
-    return SC_CONTINUE;
+  if (!top) {
+    return false;
+  }
+  switch (ap->type) {
+  case AST_FST:
+  case AST_SND:
+  case AST_ACC:
+    return top->type == AST_PAIR;
+  case AST_APP:
+    if (top->type != AST_PAIR) {
+      return false;
+    }
+    cur = Peek(top->rchild);
+    return cur->type == AST_CUR
+        || (cur->type == AST_COMP && cur->rchild->type == AST_CUR);
+  case AST_PLUS:
+    return top->type == AST_PAIR
+        && ((ast_t *)Link(top->rchild))->type == AST_QUOTE
+        && top->rchild->type == AST_QUOTE;
+  case AST_QUOTE:
+    return true;
+  default:
+    return false;
   }
-  return VisitLeaf(me, ap);
 }
 
-static statusCode_t
-VisitSnd(optim_t * const me, const ast_t *ap)
+static ast_t *
+Detach(cam_context_t * const ctx, ast_t ** const done)
 {
-  ast_t * head;
-
-  if ((head = Peek(me->stack)) && IsSibling(head)
-        && head->type == AST_PAIR) {
-    Pop(&me->stack);
-    Ast_Free((ast_t **)&head->rchild->base.link);
-    Push(&me->stack, head->rchild);
-    Pool_Free(&g_ast_pool, (node_t *)head);
-    ++me->cnt;
-    return SC_CONTINUE;
+  ast_t * run = Peek(*done);
+  ast_t * last;
+  ast_t * prev;
+
+  if (run->type != AST_COMP) {
+    return Pop(done);
+  }
+  last = run->rchild;
+  if (last == Link(last)) {
+    Pop(done);
+    Pool_Free(&ctx->ast_pool, (node_t *)run);
+    return last;
+  }
+  for (prev = last; Link(prev) != last; prev = Link(prev)) {
+    continue;
   }
-  return VisitLeaf(me, ap);
+  prev->base.link = last->base.link;
+  run->rchild = prev;
+  return last;
 }
 
-static statusCode_t
-VisitApp(optim_t * const me, const ast_t *ap)
+static void
+Unwrap(cam_context_t * const ctx, ast_t * const me)
 {
-  ast_t * head;
-  ast_t * left;
-
-  if ((head = Peek(me->stack)) && IsSibling(head)
-      && head->type == AST_PAIR && (left = Peek(head->rchild))
-      && left->type == AST_CUR) {
-    Pop(&head->rchild);
-    Ast_AddChild(head, Ast_Id());
-    Push(&me->stack, left->rchild);
-    Pool_Free(&g_ast_pool, (node_t *)left);
-    ++me->cnt;
-    return SC_CONTINUE;
-  }
-  return VisitLeaf(me, ap);
+  ast_t * child = me->rchild;
+
+  assert(child && child == Link(child));
+
+  me->type = child->type;
+  me->value = child->value;
+  me->rchild = child->rchild;
+  Pool_Free(&ctx->ast_pool, (node_t *)child);
 }
 
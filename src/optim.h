@@ -2,14 +2,15 @@
 #define OPTIM_H_
 
 #include "ast.h"
+#include "context.h"
 
 typedef struct {
-  visit_t   base;
-  node_t *  stack;
-  int       cnt;
+  visit_t           base;
+  int               cnt;
+  cam_context_t *   ctx;
 } optim_t;
 
-extern void Optim_Init(optim_t * const);
+extern void Optim_Init(optim_t * const, cam_context_t * const);
 
 #endif /* OPTIM_H_ */
 
@@ -2,46 +2,72 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
 #include <setjmp.h>
+#include <stdbool.h>
 #include <stdio.h>
-#include <string.h>
+#include <stdlib.h>
 
 #include "ast.h"
+#include "context.h"
 #include "except.h"
 #include "lexer.h"
 #include "node.h"
 #include "pool.h"
 
-typedef struct {
-  node_t  base;
-  char    value[MAXTOK + 1];
-} symbol_t;
+enum {
+  N_RULES = 256
+};
 
-static symbol_t g_pool[N_ELEMS];
-pool_t          g_symbol_pool = INIT_POOL(g_pool, N_ELEMS, symbol_t);
+typedef enum {
+  RULE_SUM,
+  RULE_APP
+} ruleType_t;
 
-static ast_t * ParseExpr(lexer_t * const, const symbol_t *);
-static ast_t * ParseVar(const char * const, const symbol_t * const);
-static ast_t * ParseNum(const char *);
-static ast_t * ParseSum(lexer_t * const, const symbol_t *);
-static ast_t * ParseApp(lexer_t * const, const symbol_t *);
-static ast_t * ParseAbs(lexer_t * const, const symbol_t *, int *);
+typedef struct rule_s {
+  ruleType_t  type;
+  ast_t *     root;
+  int         depth;
+  int         cnt;
+} rule_t;
+
+static ast_t * ParseVar(cam_context_t * const, const lexer_t * const,
+                        const int);
+static ast_t * ParseNum(cam_context_t * const, const lexer_t * const);
+static bool    Reduce(cam_context_t * const, lexer_t * const,
+                      rule_t * const, ast_t * const, const symbol_t **);
+
+static void
+Bind(cam_context_t * const ctx, const symbol_t ** saved,
+     const lexer_t * const lexer, const int depth)
+{
+  symbol_t *  symbol;
+
+  assert(saved);
+  assert(lexer);
+  assert(lexer->id >= 0 && (size_t)lexer->id < ctx->nids);
+
+  symbol = Pool_Alloc(&ctx->symbol_pool);
+  symbol->id = lexer->id;
+  symbol->binding = ctx->bindings[lexer->id];
+  ctx->bindings[lexer->id] = depth;
+  Push(saved, symbol);
+}
 
 static void
-PushNewSymbol(const symbol_t ** scope, const char * const token)
+Unbind(cam_context_t * const ctx, const symbol_t ** saved)
 {
   symbol_t *  symbol;
 
-  assert(scope);
-  assert(token);
+  assert(saved);
 
-  symbol = Pool_Alloc(&g_symbol_pool);
-  strcpy(symbol->value, token);
-  Push(scope, symbol);
+  symbol = Pop(saved);
+  ctx->bindings[symbol->id] = symbol->binding;
+  Pool_Free(&ctx->symbol_pool, symbol);
 }
 
 static void
-Consume(lexer_t * const lexer)
+Consume(cam_context_t * const ctx, lexer_t * const lexer)
 {
   int cnt;
 
@@ -50,166 +76,184 @@ Consume(lexer_t * const lexer)
     fprintf(stderr, "Unexpected end of input.\n");
     /* fall-through */
   case -1:
-    THROW;
+    THROW(ctx->handler);
   default:
     return;
   }
 }
 
 static void
-Match(lexer_t * const lexer, const tokenType_t type)
+Match(cam_context_t * const ctx, lexer_t * const lexer,
+      const tokenType_t type)
 {
   if (type != lexer->type) {
-    fprintf(stderr, "Unexpected token: %s.\n", lexer->token);
-    THROW;
+    fprintf(stderr, "Unexpected token: %.*s.\n", (int)lexer->len,
+            lexer->token);
+    THROW(ctx->handler);
   }
 }
 
 static inline void
-Expect(lexer_t * const lexer, const tokenType_t type)
+Expect(cam_context_t * const ctx, lexer_t * const lexer,
+       const tokenType_t type)
 {
-  Consume(lexer);
-  Match(lexer, type);
+  Consume(ctx, lexer);
+  Match(ctx, lexer, type);
 }
 
 ast_t *
-Parse(lexer_t * const lexer)
+Parse(cam_context_t * const ctx, lexer_t * const lexer)
 {
-  Consume(lexer);
-  return ParseExpr(lexer, NULL);
-}
-
-static ast_t *
-ParseExpr(lexer_t * const lexer, const symbol_t *scope)
-{
-  assert(lexer->type != LEX_NONE);
-
-  switch (lexer->type) {
-  case LEX_VAR:
-    return ParseVar(lexer->token, scope);
-  case LEX_NUM:
-    return ParseNum(lexer->token);
-  case LEX_LBRACK:
-    Consume(lexer);
-    if (lexer->type == LEX_PLUS) {
-      return ParseSum(lexer, scope);
+  const symbol_t *  saved = NULL;
+  size_t            nrules = 0;
+  rule_t *          rp;
+  ast_t *           ap;
+  int               depth = 0;
+
+  Consume(ctx, lexer);
+  for (;;) {
+    while (lexer->type == LEX_LBRACK) {
+      if (nrules == ctx->rules_capacity) {
+        rule_t *  tmp;
+        size_t    cnt;
+
+        cnt = ctx->rules_capacity ? 2 * ctx->rules_capacity : N_RULES;
+        if (!(tmp = realloc(ctx->rules, cnt * sizeof(rule_t)))) {
+          fprintf(stderr, "Out of memory.\n");
+          THROW(ctx->handler);
+        }
+        ctx->rules = tmp;
+        ctx->rules_capacity = cnt;
+      }
+      rp = &ctx->rules[nrules++];
+      rp->depth = depth;
+      rp->root = NULL;
+      Consume(ctx, lexer);
+      if (lexer->type == LEX_PLUS) {
+        rp->type = RULE_SUM;
+        Consume(ctx, lexer);
+      } else {
+        rp->type = RULE_APP;
+        Match(ctx, lexer, LEX_LBRACK);
+        Expect(ctx, lexer, LEX_LAMBDA);
+        Expect(ctx, lexer, LEX_LBRACK);
+        Expect(ctx, lexer, LEX_VAR);
+        Bind(ctx, &saved, lexer, depth);
+        Consume(ctx, lexer);
+        for (rp->cnt = 1; lexer->type != LEX_RBRACK; ++rp->cnt) {
+          Match(ctx, lexer, LEX_VAR);
+          Bind(ctx, &saved, lexer, depth + rp->cnt);
+          Consume(ctx, lexer);
+        }
+        Consume(ctx, lexer);
+        depth += rp->cnt;
+      }
     }
-    return ParseApp(lexer, scope);
-  default:
-    fprintf(stderr, "Unexpected token: %s.\n", lexer->token);
-    THROW;
-  }
-}
-
-static ast_t *
-ParseVar(const char * const token, const symbol_t * const scope)
-{
-  ast_t *     ap;
-  symbol_t *  it;
-
-  assert(token);
-
-  if (IsEmpty(scope)) {
-    goto error;
-  }
-  ap = Ast_Node(AST_COMP);
-  Ast_AddChild(ap, Ast_Snd());
-  it = Link(scope);
-  do {
-    if (strcmp(token, it->value) == 0) {
+    assert(lexer->type != LEX_NONE);
+
+    switch (lexer->type) {
+    case LEX_VAR:
+      ap = ParseVar(ctx, lexer, depth);
+      break;
+    case LEX_NUM:
+      ap = ParseNum(ctx, lexer);
+      break;
+    default:
+      fprintf(stderr, "Unexpected token: %.*s.\n", (int)lexer->len,
+              lexer->token);
+      THROW(ctx->handler);
+    }
+    while (nrules > 0
+           && Reduce(ctx, lexer, &ctx->rules[nrules - 1], ap, &saved)) {
+      ap = ctx->rules[--nrules].root;
+    }
+    if (nrules == 0) {
+      assert(!saved);
       return ap;
-    } else {
-      Ast_AddChild(ap, Ast_Fst());
     }
-  } while ((it = Link(it)) != Link(scope));
-error:
-  fprintf(stderr, "Unbound variable: %s.\n", token);
-  THROW;
-}
-
-static ast_t *
-ParseNum(const char *cp)
-{
-  int total = 0;
-
-  assert(isdigit(*cp));
-
-  do {
-    assert(isdigit(*cp));
-    total = (10 * total) + (*cp - '0');
-  } while (*++cp != '\0');
-  return Ast_Quote(total);
+    depth = ctx->rules[nrules - 1].depth;
+  }
 }
 
-static ast_t *
-ParseSum(lexer_t * const lexer, const symbol_t *scope)
+static bool
+Reduce(cam_context_t * const ctx, lexer_t * const lexer, rule_t * const rp,
+       ast_t * const ap, const symbol_t ** saved)
 {
-  ast_t * root;
+  int i;
 
   assert(lexer);
-  assert(lexer->type == LEX_PLUS);
-
-  Consume(lexer);
-  root = ParseExpr(lexer, scope);
-  Consume(lexer);
-  do {
-    root = Ast_Pair(root, ParseExpr(lexer, scope));
-    root = Ast_Pair(Ast_Plus(), root);
-    root = Ast_Comp(2, root, Ast_App());
-    Consume(lexer);
-  } while (lexer->type != LEX_RBRACK);
-
-  return root;
+  assert(rp);
+  assert(ap);
+
+  switch (rp->type) {
+  case RULE_SUM:
+    if (!rp->root) {
+      rp->root = ap;
+      Consume(ctx, lexer);
+      return false;
+    }
+    rp->root = Ast_Pair(ctx, rp->root, ap);
+    rp->root = Ast_Pair(ctx, Ast_Plus(ctx), rp->root);
+    rp->root = Ast_Comp(ctx, 2, rp->root, Ast_App(ctx));
+    Consume(ctx, lexer);
+    return lexer->type == LEX_RBRACK;
+  case RULE_APP:
+    if (!rp->root) {
+      Expect(ctx, lexer, LEX_RBRACK);
+      rp->root = ap;
+      for (i = rp->cnt; i > 0; --i) {
+        rp->root = Ast_Cur(ctx, rp->root);
+        Unbind(ctx, saved);
+      }
+    } else {
+      rp->root = Ast_Pair(ctx, rp->root, ap);
+      rp->root = Ast_Comp(ctx, 2, rp->root, Ast_App(ctx));
+      --rp->cnt;
+    }
+    if (rp->cnt > 0) {
+      Consume(ctx, lexer);
+      return false;
+    }
+    Expect(ctx, lexer, LEX_RBRACK);
+    return true;
+  default:
+    assert(false);
+    return false;
+  }
 }
 
 static ast_t *
-ParseApp(lexer_t * const lexer, const symbol_t *scope)
+ParseVar(cam_context_t * const ctx, const lexer_t * const lexer,
+         const int depth)
 {
-  ast_t * root;
-  int     cnt;
-
   assert(lexer);
+  assert(lexer->id >= 0 && (size_t)lexer->id < ctx->nids);
 
-  root = ParseAbs(lexer, scope, &cnt);
-  while (cnt-- > 0) {
-    Consume(lexer);
-    root = Ast_Pair(root, ParseExpr(lexer, scope));
-    root = Ast_Comp(2, root, Ast_App());
+  if (ctx->bindings[lexer->id] < 0) {
+    fprintf(stderr, "Unbound variable: %.*s.\n", (int)lexer->len,
+            lexer->token);
+    THROW(ctx->handler);
   }
-  Expect(lexer, LEX_RBRACK);
-  return root;
+  return Ast_Acc(ctx, depth - 1 - ctx->bindings[lexer->id]);
 }
 
 static ast_t *
-ParseAbs(lexer_t * const lexer, const symbol_t *scope, int *cnt)
+ParseNum(cam_context_t * const ctx, const lexer_t * const lexer)
 {
-  ast_t * ap;
-  int     i;
+  const char *  cp = lexer->token;
+  int           total = 0;
 
-  assert(lexer);
-
-  Match(lexer, LEX_LBRACK);
-  Expect(lexer, LEX_LAMBDA);
-  Expect(lexer, LEX_LBRACK);
-
-  Expect(lexer, LEX_VAR);
-  PushNewSymbol(&scope, lexer->token);
-  Consume(lexer);
-  for (*cnt = 1; lexer->type != LEX_RBRACK; ++*cnt) {
-    Match(lexer, LEX_VAR);
-    PushNewSymbol(&scope, lexer->token);
-    Consume(lexer);
-  }
+  assert(lexer->len > 0);
 
-  Consume(lexer);
-  ap = ParseExpr(lexer, scope);
-  Expect(lexer, LEX_RBRACK);
-
-  for (i = *cnt; i > 0; --i) {
-    ap = Ast_Cur(ap);
-    Pool_Free(&g_symbol_pool, Pop(&scope));
-  }
-
-  return ap;
+  do {
+    assert(isdigit((unsigned char)*cp));
+    if (total > (INT_MAX - (*cp - '0')) / 10) {
+      fprintf(stderr, "Number too large: %.*s.\n", (int)lexer->len,
+              lexer->token);
+      THROW(ctx->handler);
+    }
+    total = (10 * total) + (*cp - '0');
+  } while (++cp != lexer->token + lexer->len);
+  return Ast_Quote(ctx, total);
 }
 
@@ -2,9 +2,17 @@
 #define PARSER_H_
 
 #include "ast.h"
+#include "context.h"
 #include "lexer.h"
+#include "node.h"
 
-extern ast_t *  Parse(lexer_t * const);
+typedef struct {
+  node_t  base;
+  int     id;
+  int     binding;
+} symbol_t;
+
+extern ast_t *  Parse(cam_context_t * const, lexer_t * const);
 
 #endif /* PARSER_H_ */
 
@@ -1,48 +1,158 @@
+#if defined(POOL_HUGEPAGES)
+#define _DEFAULT_SOURCE
+#endif
 #include "pool.h"
 
+#if defined(POOL_HUGEPAGES)
+#include <sys/mman.h>
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "except.h"
 #include "node.h"
 
+#if defined(POOL_HUGEPAGES)
+enum {
+  HUGE_PAGE_SZ = 2 * 1024 * 1024
+};
+#endif
+static void       Grow(pool_t * const);
+static chunk_t *  NewChunk(size_t);
+static void       FreeChunk(chunk_t * const);
+
 void *
 Pool_Alloc(pool_t * const me)
 {
   assert(me);
 
+#if defined(CAM_STATS)
+  ++me->allocs;
+  if (++me->live > me->peak) {
+    me->peak = me->live;
+  }
+#endif
   if ((me->avail)) {
     return Pop(&me->avail);
   }
-  if (me->max < me->limit) {
-    me->max += me->size;
-    assert(me->max <= me->limit);
-    return me->max - me->size;
+  if (me->max == me->limit) {
+    Grow(me);
   }
-  fprintf(stderr, "Out of memory.\n");
-  THROW;
+  me->max += me->size;
+  assert(me->max <= me->limit);
+  return me->max - me->size;
 }
 
-void *
-Pool_Calloc(pool_t * const me)
+static void
+Grow(pool_t * const me)
 {
-  void *  ptr;
+  chunk_t * cp;
+  size_t    bytes;
 
-  assert(me);
+  bytes = sizeof(chunk_t) + me->elems * me->size;
+  if (!(cp = NewChunk(bytes))) {
+    fprintf(stderr, "Out of memory.\n");
+    THROW(*me->handler);
+  }
+  Push(&me->chunks, cp);
 
-  ptr = Pool_Alloc(me);
-  memset(ptr, 0, me->size);
-  return ptr;
+  me->max = (char *)(cp + 1);
+  me->limit = me->max + (cp->bytes - sizeof(chunk_t)) / me->size * me->size;
+  if (me->elems < MAX_ELEMS) {
+    me->elems *= 2;
+  }
+}
+
+static chunk_t *
+NewChunk(size_t bytes)
+{
+  chunk_t * cp;
+
+#if defined(POOL_HUGEPAGES)
+  if (bytes >= HUGE_PAGE_SZ) {
+    bytes = (bytes + HUGE_PAGE_SZ - 1) / HUGE_PAGE_SZ * HUGE_PAGE_SZ;
+    cp = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (cp == MAP_FAILED) {
+      cp = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (cp == MAP_FAILED) {
+        return NULL;
+      }
+      madvise(cp, bytes, MADV_HUGEPAGE);
+    }
+    cp->bytes = bytes;
+    return cp;
+  }
+#endif
+  if ((cp = malloc(bytes))) {
+    cp->bytes = bytes;
+  }
+  return cp;
+}
+
+static void
+FreeChunk(chunk_t * const cp)
+{
+#if defined(POOL_HUGEPAGES)
+  if (cp->bytes >= HUGE_PAGE_SZ) {
+    munmap(cp, cp->bytes);
+    return;
+  }
+#endif
+  free(cp);
 }
 
 void
 Pool_Clear(pool_t * const me)
 {
+  chunk_t * cp;
+
   assert(me);
 
+  while ((cp = Pop(&me->chunks))) {
+    FreeChunk(cp);
+  }
+  me->elems = N_ELEMS;
+  me->max = me->limit = NULL;
   me->avail = NULL;
-  me->max = (char *)me->start;
+#if defined(CAM_STATS)
+  me->live = 0;
+#endif
+}
+
+#if defined(CAM_STATS)
+void
+Pool_Release(pool_t * const me, node_t * const list)
+{
+  node_t *  it = list;
+  size_t    cnt = 0;
+
+  assert(me);
+
+  if (list) {
+    do {
+      ++cnt;
+      it = it->link;
+    } while (it != list);
+  }
+  me->frees += cnt;
+  me->live -= cnt;
+  Append(&me->avail, list);
+}
+#endif
+
+#if defined(CAM_STATS)
+void
+Pool_ResetPeak(pool_t * const me)
+{
+  assert(me);
+
+  if (me->peak > me->highest) {
+    me->highest = me->peak;
+  }
+  me->peak = me->live;
 }
+#endif
 
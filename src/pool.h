@@ -3,37 +3,68 @@
 
 #include <stddef.h>
 
+#include "except.h"
 #include "node.h"
 
-#define INIT_POOL(pool, elems, type) {              \
+#define INIT_POOL(type, h) {                        \
   sizeof(type),                       /* size */    \
-  (char * const)(pool),               /* start */   \
-  (char * const)((pool) + (elems)),   /* limit */   \
-  (char *)(pool),                     /* max */     \
-  NULL                                /* avail */   \
+  NULL,                               /* chunks */  \
+  N_ELEMS,                            /* elems */   \
+  NULL,                               /* max */     \
+  NULL,                               /* limit */   \
+  NULL,                               /* avail */   \
+  (h)                                 /* handler */ \
+  INIT_POOL_STATS                                   \
 }
 
+#if defined(CAM_STATS)
+#define INIT_POOL_STATS   , 0, 0, 0, 0, 0
+#else
+#define INIT_POOL_STATS
+#endif
+
+#if defined(CAM_STATS)
+#define Pool_Free(me, item)       ((me)->frees++, (me)->live--,     \
+                                   Push(&(me)->avail, (item)))
+#define Pool_FreeList(me, item)   Pool_Release((me), (node_t *)(item))
+#else
 #define Pool_Free(me, item)       Push(&(me)->avail, (item))
 #define Pool_FreeList(me, item)   Append(&(me)->avail, (item))
+#endif
 
 enum {
-  N_ELEMS = 1024
+  N_ELEMS = 1024,
+  MAX_ELEMS = 1 << 20
 };
 
 typedef struct {
   size_t        size;
-  char * const  start;
-  char * const  limit;
+  node_t *      chunks;
+  size_t        elems;
   char *        max;
+  char *        limit;
   node_t *      avail;
+  jmp_buf * const * handler;
+#if defined(CAM_STATS)
+  size_t        allocs;
+  size_t        frees;
+  size_t        live;
+  size_t        peak;
+  size_t        highest;
+#endif
 } pool_t;
 
-extern pool_t   g_ast_pool;
-extern pool_t   g_env_pool;
-extern pool_t   g_symbol_pool;
+typedef struct {
+  node_t        base;
+  size_t        bytes;
+} chunk_t;
 
 extern void *   Pool_Alloc(pool_t * const);
-extern void *   Pool_Calloc(pool_t * const);
+#if defined(CAM_STATS)
+extern void     Pool_Release(pool_t * const, node_t * const);
+extern void     Pool_ResetPeak(pool_t * const);
+#endif
+
 extern void     Pool_Clear(pool_t * const);
 
 #endif /* POOL_H_ */
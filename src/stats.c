@@ -0,0 +1,96 @@
+#include "stats.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "context.h"
+#include "opcode.h"
+#include "pool.h"
+
+#if defined(CAM_STATS)
+static const char * const MNEMONICS[] = {
+  "fst", "snd", "acc", "push", "swap", "cons", "cur", "clos", "app", "tapp",
+  "ret", "quote", "plus", "halt"
+};
+
+static void GetPool(const pool_t * const, poolStats_t * const);
+static void PrintPool(FILE * const, const char * const,
+                      const poolStats_t * const, const poolStats_t * const);
+
+void
+Stats_Get(const cam_context_t * const ctx, stats_t * const me)
+{
+  assert(ctx);
+  assert(me);
+
+  me->counters = ctx->counters;
+  GetPool(&ctx->ast_pool, &me->ast_pool);
+  GetPool(&ctx->env_pool, &me->env_pool);
+  GetPool(&ctx->symbol_pool, &me->symbol_pool);
+}
+
+void
+Stats_Reset(cam_context_t * const ctx)
+{
+  assert(ctx);
+
+  Pool_ResetPeak(&ctx->ast_pool);
+  Pool_ResetPeak(&ctx->env_pool);
+  Pool_ResetPeak(&ctx->symbol_pool);
+}
+
+static void
+GetPool(const pool_t * const pool, poolStats_t * const me)
+{
+  me->allocs = pool->allocs;
+  me->frees = pool->frees;
+  me->peak = pool->peak;
+  me->highest = pool->peak > pool->highest ? pool->peak : pool->highest;
+}
+
+void
+Stats_Print(FILE * const out, const stats_t * const me,
+            const stats_t * const since)
+{
+  const counters_t *  cp = since ? &since->counters : NULL;
+  size_t              cnt[N_OPCODES];
+  size_t              total = 0;
+  size_t              i;
+
+  assert(out);
+  assert(me);
+
+  for (i = 0; i < N_OPCODES; ++i) {
+    cnt[i] = me->counters.instrs[i] - (cp ? cp->instrs[i] : 0);
+    total += cnt[i];
+  }
+  fprintf(out, "  instructions: %zu", total);
+  for (i = 0; i < N_OPCODES; ++i) {
+    if (cnt[i] > 0) {
+      fprintf(out, ", %s %zu", MNEMONICS[i], cnt[i]);
+    }
+  }
+  fprintf(out, "\n");
+  PrintPool(out, "ast", &me->ast_pool, since ? &since->ast_pool : NULL);
+  PrintPool(out, "env", &me->env_pool, since ? &since->env_pool : NULL);
+  PrintPool(out, "symbol", &me->symbol_pool,
+            since ? &since->symbol_pool : NULL);
+  fprintf(out, "  ASTs released: %zu\n"
+               "  collections: %zu, nodes copied: %zu\n",
+          me->counters.flattens - (cp ? cp->flattens : 0),
+          me->counters.collections - (cp ? cp->collections : 0),
+          me->counters.copied - (cp ? cp->copied : 0));
+}
+
+static void
+PrintPool(FILE * const out, const char * const name,
+          const poolStats_t * const me, const poolStats_t * const since)
+{
+  fprintf(out, "  %s pool: %zu allocs, %zu frees, peak %zu\n", name,
+          me->allocs - (since ? since->allocs : 0),
+          me->frees - (since ? since->frees : 0),
+          since ? me->peak : me->highest);
+}
+#endif
+
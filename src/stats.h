@@ -0,0 +1,31 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "context.h"
+
+#if defined(CAM_STATS)
+typedef struct {
+  size_t      allocs;
+  size_t      frees;
+  size_t      peak;
+  size_t      highest;
+} poolStats_t;
+
+typedef struct {
+  counters_t  counters;
+  poolStats_t ast_pool;
+  poolStats_t env_pool;
+  poolStats_t symbol_pool;
+} stats_t;
+
+extern void Stats_Get(const cam_context_t * const, stats_t * const);
+extern void Stats_Reset(cam_context_t * const);
+extern void Stats_Print(FILE * const, const stats_t * const,
+                        const stats_t * const);
+#endif
+
+#endif /* STATS_H_ */
+
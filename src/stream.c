@@ -0,0 +1,241 @@
+#define _POSIX_C_SOURCE 200809L
+#include "stream.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char DIGITS[] =
+  "00010203040506070809" "10111213141516171819"
+  "20212223242526272829" "30313233343536373839"
+  "40414243444546474849" "50515253545556575859"
+  "60616263646566676869" "70717273747576777879"
+  "80818283848586878889" "90919293949596979899";
+
+enum {
+  READER_SZ = 1 << 16
+};
+
+static bool     Map(reader_t * const);
+static bool     Fill(reader_t * const);
+
+void
+Writer_Init(writer_t * const me, FILE * const stream)
+{
+  assert(me);
+  assert(stream);
+
+  me->len = 0;
+  me->fd = fileno(stream);
+  me->failed = false;
+}
+
+bool
+Writer_Flush(writer_t * const me)
+{
+  ssize_t cnt;
+  size_t  done = 0;
+
+  assert(me);
+
+  while (done < me->len) {
+    if ((cnt = write(me->fd, me->buff + done, me->len - done)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      me->len = 0;
+      me->failed = true;
+      return false;
+    }
+    done += (size_t)cnt;
+  }
+  me->len = 0;
+  return !me->failed;
+}
+
+static inline void
+Write(writer_t * const me, const char * const bytes, const size_t cnt)
+{
+  assert(cnt <= WRITER_SZ);
+
+  if (me->len + cnt > WRITER_SZ) {
+    Writer_Flush(me);
+  }
+  memcpy(me->buff + me->len, bytes, cnt);
+  me->len += cnt;
+}
+
+void
+Writer_Char(writer_t * const me, const char c)
+{
+  assert(me);
+
+  Write(me, &c, 1);
+}
+
+void
+Writer_Int(writer_t * const me, const int num)
+{
+  char            buff[24];
+  char *          cp = buff + sizeof(buff);
+  unsigned int    n = num < 0 ? 0U - (unsigned int)num : (unsigned int)num;
+  unsigned int    r;
+
+  assert(me);
+
+  while (n >= 100) {
+    r = n % 100;
+    n /= 100;
+    *--cp = DIGITS[2 * r + 1];
+    *--cp = DIGITS[2 * r];
+  }
+  if (n >= 10) {
+    *--cp = DIGITS[2 * n + 1];
+    *--cp = DIGITS[2 * n];
+  } else {
+    *--cp = (char)('0' + n);
+  }
+  if (num < 0) {
+    *--cp = '-';
+  }
+  Write(me, cp, (size_t)(buff + sizeof(buff) - cp));
+}
+
+bool
+Reader_Init(reader_t * const me, FILE * const stream, writer_t * const tie)
+{
+  assert(me);
+  assert(stream);
+
+  me->fd = fileno(stream);
+  me->tie = tie;
+  me->len = me->pos = 0;
+  me->eof = false;
+  if (Map(me)) {
+    return true;
+  }
+  me->mapped = false;
+  me->capacity = READER_SZ;
+  if (!(me->buff = malloc(me->capacity))) {
+    fprintf(stderr, "Out of memory.\n");
+    return false;
+  }
+  return true;
+}
+
+static bool
+Map(reader_t * const me)
+{
+  struct stat st;
+  void *      ptr;
+
+  if (fstat(me->fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+    return false;
+  }
+  ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, me->fd, 0);
+  if (ptr == MAP_FAILED) {
+    return false;
+  }
+  posix_madvise(ptr, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+  me->buff = ptr;
+  me->len = me->capacity = (size_t)st.st_size;
+  me->mapped = me->eof = true;
+  return true;
+}
+
+void
+Reader_Free(reader_t * const me)
+{
+  assert(me);
+
+  if (me->mapped) {
+    munmap(me->buff, me->capacity);
+  } else {
+    free(me->buff);
+  }
+  me->buff = NULL;
+}
+
+const char *
+Reader_Next(reader_t * const me, size_t * const len)
+{
+  const char *  term;
+  size_t        n = 0;
+  long          depth = 0;
+  char          c;
+
+  assert(me);
+  assert(len);
+
+  for (;; ++me->pos) {
+    if (me->pos == me->len && !Fill(me)) {
+      return NULL;
+    }
+    if (!isspace((unsigned char)me->buff[me->pos])) {
+      break;
+    }
+  }
+  for (;; ++n) {
+    if (me->pos + n == me->len && !Fill(me)) {
+      break;
+    }
+    if ((c = me->buff[me->pos + n]) == '(') {
+      ++depth;
+    } else if (c == ')') {
+      --depth;
+    } else if (c == '\n' && depth <= 0) {
+      break;
+    }
+  }
+  term = me->buff + me->pos;
+  me->pos += n < me->len - me->pos ? n + 1 : n;
+  *len = n;
+  return term;
+}
+
+static bool
+Fill(reader_t * const me)
+{
+  ssize_t cnt;
+  char *  cp;
+
+  if (me->eof) {
+    return false;
+  }
+  if (me->tie) {
+    Writer_Flush(me->tie);
+  }
+  memmove(me->buff, me->buff + me->pos, me->len - me->pos);
+  me->len -= me->pos;
+  me->pos = 0;
+  if (me->len == me->capacity) {
+    if (!(cp = realloc(me->buff, 2 * me->capacity))) {
+      fprintf(stderr, "Out of memory.\n");
+      me->eof = true;
+      return false;
+    }
+    me->buff = cp;
+    me->capacity *= 2;
+  }
+  do {
+    cnt = read(me->fd, me->buff + me->len, me->capacity - me->len);
+  } while (cnt < 0 && errno == EINTR);
+  if (cnt <= 0) {
+    if (cnt < 0) {
+      perror("read");
+    }
+    me->eof = true;
+    return false;
+  }
+  me->len += (size_t)cnt;
+  return true;
+}
+
@@ -0,0 +1,40 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+enum {
+  WRITER_SZ = 1 << 16
+};
+
+typedef struct {
+  char    buff[WRITER_SZ];
+  size_t  len;
+  int     fd;
+  bool    failed;
+} writer_t;
+
+typedef struct {
+  char *      buff;
+  size_t      len;
+  size_t      pos;
+  size_t      capacity;
+  writer_t *  tie;
+  int         fd;
+  bool        mapped;
+  bool        eof;
+} reader_t;
+
+extern void           Writer_Init(writer_t * const, FILE * const);
+extern void           Writer_Int(writer_t * const, const int);
+extern void           Writer_Char(writer_t * const, const char);
+extern bool           Writer_Flush(writer_t * const);
+extern bool           Reader_Init(reader_t * const, FILE * const,
+                                  writer_t * const);
+extern void           Reader_Free(reader_t * const);
+extern const char *   Reader_Next(reader_t * const, size_t * const);
+
+#endif /* STREAM_H_ */
+
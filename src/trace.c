@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "trace.h"
+
+#include <pthread.h>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+enum {
+  N_EVENTS = 4096
+};
+
+typedef struct event_s {
+  const char *  name;
+  uint64_t      ts;
+  char          ph;
+} event_t;
+
+static uint64_t Now(void);
+static void     Flush(cam_context_t * const);
+
+static uint64_t
+Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+bool
+Trace_Open(trace_t * const me, const char * const path)
+{
+  assert(me);
+  assert(path);
+
+  if (!(me->file = fopen(path, "w"))) {
+    return false;
+  }
+  pthread_mutex_init(&me->lock, NULL);
+  me->start = Now();
+  me->empty = true;
+  me->ncontexts = 0;
+  fprintf(me->file, "[");
+  return true;
+}
+
+bool
+Trace_Close(trace_t * const me)
+{
+  bool  ok;
+
+  assert(me);
+
+  fprintf(me->file, "\n]\n");
+  ok = !ferror(me->file);
+  if (fclose(me->file) != 0) {
+    ok = false;
+  }
+  pthread_mutex_destroy(&me->lock);
+  return ok;
+}
+
+void
+Trace_Attach(cam_context_t * const ctx, trace_t * const me)
+{
+  assert(ctx);
+  assert(me);
+
+  if (ctx->trace) {
+    return;
+  }
+  if (!(ctx->events = malloc(N_EVENTS * sizeof(event_t)))) {
+    fprintf(stderr, "Out of memory.\n");
+    return;
+  }
+  pthread_mutex_lock(&me->lock);
+  ctx->tid = ++me->ncontexts;
+  pthread_mutex_unlock(&me->lock);
+  ctx->trace = me;
+  ctx->nevents = ctx->spans = 0;
+}
+
+void
+Trace_Event(cam_context_t * const ctx, const char * const name,
+            const char ph)
+{
+  event_t * ep;
+
+  assert(ctx->trace);
+
+  if (ctx->nevents == N_EVENTS) {
+    Flush(ctx);
+  }
+  ep = &ctx->events[ctx->nevents++];
+  ep->name = name;
+  ep->ph = ph;
+  ep->ts = Now();
+  if (ph == 'B') {
+    ++ctx->spans;
+  } else {
+    assert(ctx->spans > 0);
+    --ctx->spans;
+  }
+}
+
+static void
+Flush(cam_context_t * const ctx)
+{
+  trace_t * const me = ctx->trace;
+  event_t *       ep;
+  size_t          i;
+
+  pthread_mutex_lock(&me->lock);
+  for (i = 0; i < ctx->nevents; ++i) {
+    ep = &ctx->events[i];
+    fprintf(me->file, "%s\n{", me->empty ? "" : ",");
+    if (ep->name) {
+      fprintf(me->file, "\"name\":\"%s\",", ep->name);
+    }
+    fprintf(me->file, "\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+            ep->ph, (double)(ep->ts - me->start) / 1e3, ctx->tid);
+    me->empty = false;
+  }
+  pthread_mutex_unlock(&me->lock);
+  ctx->nevents = 0;
+}
+
+void
+Trace_Unwind(cam_context_t * const ctx)
+{
+  assert(ctx);
+
+  while (ctx->trace && ctx->spans > 0) {
+    Trace_Event(ctx, NULL, 'E');
+  }
+}
+
+void
+Trace_Detach(cam_context_t * const ctx)
+{
+  assert(ctx);
+
+  if (ctx->trace) {
+    Trace_Unwind(ctx);
+    Flush(ctx);
+    free(ctx->events);
+    ctx->events = NULL;
+    ctx->trace = NULL;
+  }
+}
+
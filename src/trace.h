@@ -0,0 +1,33 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "context.h"
+
+#define Trace_Begin(cx, name) \
+  ((cx)->trace ? Trace_Event((cx), (name), 'B') : (void)0)
+#define Trace_End(cx) \
+  ((cx)->trace ? Trace_Event((cx), NULL, 'E') : (void)0)
+
+typedef struct trace_s {
+  FILE *          file;
+  pthread_mutex_t lock;
+  uint64_t        start;
+  bool            empty;
+  unsigned int    ncontexts;
+} trace_t;
+
+extern bool Trace_Open(trace_t * const, const char * const);
+extern bool Trace_Close(trace_t * const);
+extern void Trace_Attach(cam_context_t * const, trace_t * const);
+extern void Trace_Event(cam_context_t * const, const char * const,
+                        const char);
+extern void Trace_Unwind(cam_context_t * const);
+extern void Trace_Detach(cam_context_t * const);
+
+#endif /* TRACE_H_ */
+